@@ -0,0 +1,183 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <latch>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#include "replay.h"
+
+
+void BatchSummary::log() const {
+    if (games.empty()) {
+        spdlog::info("No games were played");
+        return;
+    }
+
+    std::vector<size_t> lines;
+    size_t total_pieces = 0, total_lines = 0, total_frames = 0, topped_out = 0, failed_paths = 0;
+    for (const auto &game: games) {
+        lines.push_back(game.line_count);
+        total_pieces += game.piece_count;
+        total_lines += game.line_count;
+        total_frames += game.frame_count;
+        topped_out += game.topped_out;
+        failed_paths += game.failed_path_count;
+    }
+    std::ranges::sort(lines);
+
+    const auto count = static_cast<double>(games.size());
+    const auto mean = static_cast<double>(total_lines) / count;
+    double variance = 0.;
+    for (const auto line: lines) {
+        variance += (static_cast<double>(line) - mean) * (static_cast<double>(line) - mean);
+    }
+    const auto seconds = std::chrono::duration<double>(wall_time).count();
+
+    spdlog::info("{} games in {:.2f} s ({:.1f} games/s, {:.0f} pieces/s, {:.0f} frames/s)", games.size(), seconds,
+                 count / seconds, static_cast<double>(total_pieces) / seconds,
+                 static_cast<double>(total_frames) / seconds);
+    spdlog::info("Lines: mean {:.1f}, stddev {:.1f}, min {}, median {}, max {}", mean, std::sqrt(variance / count),
+                 lines.front(), lines[lines.size() / 2], lines.back());
+    spdlog::info("Pieces: {} in total, {:.1f} per game; {} games topped out ({:.1f}%)", total_pieces,
+                 static_cast<double>(total_pieces) / count, topped_out,
+                 static_cast<double>(topped_out) / count * 100.);
+    if (failed_paths != 0) {
+        spdlog::error("{} pieces were not placed where the bot planned", failed_paths);
+    }
+}
+
+void BatchSummary::write_csv(const std::filesystem::path &path) const {
+    std::ofstream stream{path};
+    if (!stream) {
+        throw std::runtime_error(std::format("Failed to open {} for writing.", path.string()));
+    }
+    stream << "seed,pieces,lines,frames,topped_out,failed_paths,microseconds\n";
+    for (const auto &game: games) {
+        stream << std::format("{},{},{},{},{},{},{}\n", game.seed, game.piece_count, game.line_count,
+                              game.frame_count, game.topped_out ? 1 : 0, game.failed_path_count,
+                              std::chrono::duration_cast<std::chrono::microseconds>(game.duration).count());
+    }
+}
+
+BatchRunner::BatchRunner(BatchConfig config, const size_t thread_count) :
+    config_(std::move(config)), thread_pool_(thread_count) {}
+
+BatchSummary BatchRunner::run_(const size_t count, const std::function<GameStats(size_t)> &play,
+                               const std::function<void(size_t)> &on_finished) {
+    BatchSummary summary;
+    summary.games.resize(count);
+    // 任务里的异常不能让它逃到工作线程外面，先存下来，全部结束之后再抛
+    std::vector<std::exception_ptr> exceptions(count);
+    std::atomic_size_t finished{};
+    std::latch done{static_cast<std::ptrdiff_t>(count)};
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t idx = 0; idx < count; idx++) {
+        thread_pool_.submit([&, idx] {
+            try {
+                summary.games[idx] = play(idx);
+            } catch (...) {
+                exceptions[idx] = std::current_exception();
+            }
+            const auto finished_count = finished.fetch_add(1, std::memory_order_relaxed) + 1;
+            if (on_finished) {
+                on_finished(finished_count);
+            }
+            done.count_down();
+        });
+    }
+    done.wait();
+    summary.wall_time = std::chrono::steady_clock::now() - start;
+
+    for (const auto &exception: exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+    return summary;
+}
+
+BatchSummary BatchRunner::run_bot_games(const size_t game_count, const std::function<void(size_t)> &on_finished) {
+    return run_(
+            game_count, [this](const size_t idx) { return play_bot_game(config_.first_seed + idx, config_); },
+            on_finished);
+}
+
+BatchSummary BatchRunner::run_replays(const std::vector<std::filesystem::path> &paths,
+                                      const std::function<void(size_t)> &on_finished) {
+    // 先在调用线程上全部读进来，读不出来的录像马上就能报错
+    std::vector<Replay> replays;
+    replays.reserve(paths.size());
+    for (const auto &path: paths) {
+        replays.push_back(Replay::load(path));
+    }
+
+    return run_(
+            replays.size(),
+            [&replays](const size_t idx) {
+                const auto start = std::chrono::steady_clock::now();
+                const auto game_data = replays[idx].play();
+                return GameStats{replays[idx].seed,
+                                 game_data.piece_count,
+                                 game_data.clear_line_count,
+                                 game_data.logical_frame_count,
+                                 game_data.topped_out,
+                                 std::chrono::steady_clock::now() - start};
+            },
+            on_finished);
+}
+
+GameStats BatchRunner::play_bot_game(const uint64_t seed, const BatchConfig &config) {
+    const auto start = std::chrono::steady_clock::now();
+    GameStats stats{.seed = seed};
+
+    GameData game_data{seed};
+    const auto start_line_count =
+            (std::clamp<uint32_t>(config.start_level, 1, ScoreState::max_level) - 1) * ScoreState::lines_per_level;
+    game_data.clear_line_count = start_line_count;
+    game_data.start();
+    const auto move_generator = std::make_unique<MoveGenerator>();
+    while (game_data.piece_count < config.max_pieces) {
+        // 不限时间，搜满为止，结果只取决于局面和设置
+        const auto bot_move =
+                Bot::search(game_data, std::chrono::steady_clock::time_point::max(), nullptr, config.bot_config);
+        if (!bot_move) {
+            stats.topped_out = true;
+            break;
+        }
+        if (config.think_frames == 0) {
+            stats.failed_path_count += perform(game_data, bot_move->path) ? 0 : 1;
+        } else {
+            const auto piece_id = game_data.piece_count;
+            for (size_t idx = 0; idx < config.think_frames && game_data.piece_count == piece_id; idx++) {
+                game_data.step(FrameInput{});
+            }
+            // 等太久的话方块已经自己锁定了，这不是操作序列的问题，不算没放对。
+            // 到不了的话和游戏里一样，还是按原来的操作序列放下
+            if (game_data.piece_count == piece_id) {
+                const auto replanned = replan(*move_generator, game_data, bot_move->placement);
+                const auto performed = perform(game_data, replanned.value_or(bot_move->path));
+                stats.failed_path_count += replanned && performed ? 0 : 1;
+            }
+        }
+        // 推进一帧，让 step() 来消行、补充预览块
+        game_data.step(FrameInput{});
+        if (game_data.topped_out) {
+            stats.topped_out = true;
+            break;
+        }
+    }
+
+    stats.piece_count = game_data.piece_count;
+    stats.line_count = game_data.clear_line_count - start_line_count;
+    stats.frame_count = game_data.logical_frame_count;
+    stats.duration = std::chrono::steady_clock::now() - start;
+    return stats;
+}
@@ -0,0 +1,108 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "bot.h"
+#include "thread_pool.h"
+
+
+/// 批量模拟的设置。
+class BatchConfig {
+public:
+    /// 第一局的种子，第 idx 局用 first_seed + idx
+    uint64_t first_seed = 1;
+    /// 每局最多放多少块，放满了就算这一局结束
+    size_t max_pieces = 1000;
+    /// 开局的等级，当作已经消了这么多等级的行，一开始就是这个等级的重力
+    uint32_t start_level = 1;
+    /// 每个方块搜完之后先空走几帧再放下，像游戏里机器人思考的时候一样让重力把方块往下拉，
+    /// 再从拉下去的位置重新规划。为 0 时搜完马上放下
+    size_t think_frames = 0;
+    /// 机器人的设置。批量模拟时不限时间，每一步都搜满 preview_count 层，同样的设置总是得到同样的结果
+    BotConfig bot_config{.beam_width = 64};
+};
+
+/// 一局的结果。
+class GameStats {
+public:
+    /// 开局的种子
+    uint64_t seed{};
+    /// 放下的方块数
+    size_t piece_count{};
+    /// 消除的行数，不算开局的等级当作已经消了的
+    size_t line_count{};
+    /// 逻辑帧数
+    size_t frame_count{};
+    /// 是否死了（新方块出生的位置被占了，或者无处可放）
+    bool topped_out{};
+    /// 模拟这一局用的时间
+    std::chrono::nanoseconds duration{};
+    /// 没能按机器人的计划放下的方块数：从现在的位置到不了它选的落点，或者操作序列有一步失败了
+    size_t failed_path_count{};
+};
+
+/// 一批的结果。
+class BatchSummary {
+public:
+    /// 每一局的结果，和提交的顺序一样
+    std::vector<GameStats> games;
+    /// 整批用的时间
+    std::chrono::nanoseconds wall_time{};
+
+    /// 把汇总的统计写进日志。
+    void log() const;
+
+    /// 把每一局的结果写成 CSV。
+    /// @param path 文件路径
+    /// @exception std::runtime_error 文件打不开的时候，抛出这个 exception。
+    void write_csv(const std::filesystem::path &path) const;
+};
+
+/// 批量模拟。在线程池上同时跑许多局互不相干的无头游戏，一局一个任务。
+///
+/// 每个任务只读设置、只写自己那一局的结果，任务之间没有共享的可变状态。
+class BatchRunner {
+    /// 设置
+    BatchConfig config_;
+    /// 跑游戏的线程池
+    ThreadPool thread_pool_;
+
+    /// 在线程池上跑 count 个任务，等它们都结束。
+    /// @param count 任务数
+    /// @param play 跑第 idx 局
+    /// @param on_finished 每一局结束时调用，参数是已经结束的局数。会在工作线程上调用
+    BatchSummary run_(size_t count, const std::function<GameStats(size_t)> &play,
+                      const std::function<void(size_t)> &on_finished);
+
+public:
+    /// @param config 设置
+    /// @param thread_count 线程数，不填就是硬件线程数
+    explicit BatchRunner(BatchConfig config, size_t thread_count = std::thread::hardware_concurrency());
+
+    /// 让机器人玩 game_count 局。
+    /// @param game_count 局数
+    /// @param on_finished 每一局结束时调用，参数是已经结束的局数。会在工作线程上调用
+    BatchSummary run_bot_games(size_t game_count, const std::function<void(size_t)> &on_finished = {});
+
+    /// 回放一批录像。
+    /// @param paths 录像文件的路径
+    /// @param on_finished 每一局结束时调用，参数是已经结束的局数。会在工作线程上调用
+    /// @exception std::runtime_error 有录像读不出来的时候，抛出这个 exception。
+    BatchSummary run_replays(const std::vector<std::filesystem::path> &paths,
+                             const std::function<void(size_t)> &on_finished = {});
+
+    /// 在调用线程上让机器人玩一局。
+    /// @param seed 种子
+    /// @param config 设置
+    /// @return 这一局的结果
+    static GameStats play_bot_game(uint64_t seed, const BatchConfig &config);
+};
+
+
+#endif // BATCH_RUNNER_H
@@ -0,0 +1,388 @@
+/// Zeetris 2 的基准测试：在一组固定种子生成的场地上测引擎里最常用的几个操作，报告每次操作的耗时和内存分配次数。
+///
+/// 用法：zeetris_bench [名字中包含的字符串]
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <print>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "field_vertices.h"
+#include "game_data.h"
+#include "move_generator.h"
+#include "rng.h"
+#include "rollback.h"
+
+
+namespace {
+    /// 程序开始以来 operator new 被调用的次数
+    std::atomic_size_t allocation_count{0};
+    /// 基准的校验值写到这里，防止编译器把被测的计算优化掉
+    volatile uint64_t checksum_sink;
+} // namespace
+
+// 替换全局的 operator new，数一数每次操作分配了几次内存
+void *operator new(const std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void *operator new[](const std::size_t size) { return ::operator new(size); }
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+void operator delete[](void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+namespace {
+    /// 生成场地用的种子，改了它基准就和以前的结果没法比了
+    constexpr uint64_t corpus_seed = 20250301;
+    /// 场地的个数
+    constexpr size_t corpus_size = 256;
+    /// 场地的最大高度，再高就换一局
+    constexpr int32_t corpus_max_height = 16;
+
+    /// 每个基准的采样次数，报告中位数
+    constexpr size_t sample_count = 7;
+    /// 每次采样至少跑多久
+    constexpr std::chrono::milliseconds min_sample_time{20};
+
+    /// 一个基准的结果。
+    class BenchResult {
+    public:
+        std::string_view name;
+        /// 每次操作的耗时，各次采样的中位数 (ns)
+        double ns_per_op{};
+        /// 每次操作的内存分配次数，所有采样的平均
+        double allocations_per_op{};
+        /// 所有采样中一共执行了多少次操作
+        size_t op_count{};
+    };
+
+    /// 生成一组真实对局中会出现的场地。
+    ///
+    /// 每一局从一个固定的种子开始，用 MoveGenerator 列出所有落点，在最低的四分之一里随机选一个放下，
+    /// 这样得到的场地有高有低、有空洞也有快满的行。每隔几块记下一个场地，堆得太高或者死了就换一局。
+    /// 同一个 corpus_seed 总是得到同样的场地。
+    std::vector<GameData> make_corpus() {
+        std::vector<GameData> corpus;
+        MoveGenerator move_generator;
+        PieceRng rng{corpus_seed};
+        std::vector<Placement> candidates;
+
+        for (uint64_t game_seed = corpus_seed; corpus.size() < corpus_size; game_seed++) {
+            GameData game_data{game_seed};
+            game_data.start();
+            while (corpus.size() < corpus_size) {
+                candidates.clear();
+                for (const auto &placement: move_generator.generate(game_data)) {
+                    if (!placement.use_hold) {
+                        candidates.push_back(placement);
+                    }
+                }
+                if (candidates.empty()) {
+                    break;
+                }
+                const auto top_of = [](const Placement &placement) {
+                    return std::ranges::max(placement.to_block().points, {}, &point<int32_t>::y).y;
+                };
+                std::ranges::sort(candidates, {}, top_of);
+                const auto lowest_count = static_cast<uint32_t>(std::max<size_t>(candidates.size() / 4, 1));
+                const auto &placement = candidates[uniform_below(rng, lowest_count)];
+
+                game_data.current_block = placement.to_block();
+                game_data.current_block_rotation_state = placement.rotation_state;
+                game_data.lock();
+                game_data.clear_lines();
+                if (game_data.next_queue.size() <= 7) {
+                    game_data.new_bag();
+                }
+                game_data.dirty_rows = 0;
+
+                if (std::ranges::max(game_data.column_heights) > corpus_max_height ||
+                    !game_data.check(game_data.current_block)) {
+                    break;
+                }
+                if (uniform_below(rng, 3) == 0) {
+                    corpus.push_back(game_data);
+                }
+            }
+        }
+        return corpus;
+    }
+
+    /// 跑一个基准。
+    /// @param name 名字
+    /// @param ops_per_pass 一遍 pass 执行多少次操作
+    /// @param pass 跑一遍所有场地，返回一个校验值，防止编译器把计算优化掉
+    template<typename Pass>
+    BenchResult run_benchmark(const std::string_view name, const size_t ops_per_pass, Pass &&pass) {
+        using clock = std::chrono::steady_clock;
+        uint64_t checksum = 0;
+
+        // 先估计一下一次采样要跑几遍，顺便预热
+        size_t pass_count = 1;
+        while (true) {
+            const auto start = clock::now();
+            for (size_t idx = 0; idx < pass_count; idx++) {
+                checksum += pass();
+            }
+            if (clock::now() - start >= min_sample_time) {
+                break;
+            }
+            pass_count *= 2;
+        }
+
+        std::array<double, sample_count> samples{};
+        const auto allocations_before = allocation_count.load(std::memory_order_relaxed);
+        for (auto &sample: samples) {
+            const auto start = clock::now();
+            for (size_t idx = 0; idx < pass_count; idx++) {
+                checksum += pass();
+            }
+            const auto end = clock::now();
+            sample = std::chrono::duration<double, std::nano>(end - start).count() /
+                     static_cast<double>(pass_count * ops_per_pass);
+        }
+        const auto allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+
+        checksum_sink = checksum;
+
+        std::ranges::sort(samples);
+        const auto op_count = sample_count * pass_count * ops_per_pass;
+        return {name, samples[sample_count / 2],
+                static_cast<double>(allocations) / static_cast<double>(op_count), op_count};
+    }
+
+    /// 把方块平移一下，不检查碰撞。
+    block translated(block block, const point<int32_t> offset) {
+        for (auto &[y, x]: block.points) {
+            y += offset.y;
+            x += offset.x;
+        }
+        block.anchor.y += offset.y;
+        block.anchor.x += offset.x;
+        return block;
+    }
+} // namespace
+
+int main(const int argc, char *argv[]) {
+    const std::span args{argv, static_cast<size_t>(argc)};
+    const std::string_view filter = args.size() >= 2 ? args[1] : "";
+
+    const auto corpus = make_corpus();
+    // 被测的操作会改场地，在副本上做
+    auto scratch = corpus;
+
+    size_t total_height = 0;
+    for (const auto &game_data: corpus) {
+        total_height += static_cast<size_t>(std::ranges::max(game_data.column_heights));
+    }
+    std::println("{} boards from seed {}, mean max height {:.1f}", corpus.size(), corpus_seed,
+                 static_cast<double>(total_height) / static_cast<double>(corpus.size()));
+
+    // check()：当前方块在出生点和落点的那一行左右平移，有的合法有的不合法
+    std::vector<std::pair<size_t, block>> probes;
+    for (size_t idx = 0; idx < corpus.size(); idx++) {
+        for (int32_t dx = -5; dx <= 5; dx++) {
+            probes.emplace_back(idx, translated(corpus[idx].current_block, {0, dx}));
+            probes.emplace_back(idx, translated(corpus[idx].shadow_block, {0, dx}));
+        }
+    }
+
+    // clear_lines()：把影子锁定下去但还没有消行的场地
+    std::vector<GameData> pending;
+    for (const auto &game_data: corpus) {
+        auto &locked = pending.emplace_back(game_data);
+        for (auto &[y, x]: locked.shadow_block.points) {
+            locked.matrix[y] |= static_cast<uint16_t>(1u << x);
+            locked.matrix_color[y][x] = locked.current_block_type;
+        }
+        locked.update_column_heights();
+        locked.update_matrix_hash();
+    }
+    const auto restore_board = [](GameData &target, const GameData &source) {
+        target.matrix = source.matrix;
+        target.matrix_color = source.matrix_color;
+        target.column_heights = source.column_heights;
+    };
+
+    constexpr size_t matrix_height = GameData::height_main + GameData::height_buffer;
+    constexpr size_t vertices_per_row = GameData::width * 6;
+    std::vector<sf::Vertex> vertices_matrix(matrix_height * vertices_per_row);
+    std::array<sf::Vertex, 4 * 6> vertices_current_block;
+    std::array<sf::Vertex, 4 * 6> vertices_shadow_block;
+    const auto origin = field_origin({1366, 768});
+
+    std::vector<BenchResult> results;
+    const auto bench = [&](const std::string_view name, const size_t ops_per_pass, auto &&pass) {
+        if (name.find(filter) != std::string_view::npos) {
+            results.push_back(run_benchmark(name, ops_per_pass, pass));
+        }
+    };
+
+    bench("check", probes.size(), [&] {
+        uint64_t checksum = 0;
+        for (const auto &[idx, probe]: probes) {
+            checksum += corpus[idx].check(probe);
+        }
+        return checksum;
+    });
+
+    bench("move", corpus.size() * 3, [&] {
+        uint64_t checksum = 0;
+        for (auto &game_data: scratch) {
+            for (const auto offset: {point<int32_t>{0, -1}, point<int32_t>{0, 1}, point<int32_t>{-1, 0}}) {
+                auto block = game_data.current_block;
+                checksum += game_data.move(block, offset, false);
+            }
+        }
+        return checksum;
+    });
+
+    // 在落点旋转，贴着地面和墙的时候才会用到后面的踢墙偏移
+    bench("rotate", corpus.size() * 2, [&] {
+        uint64_t checksum = 0;
+        for (auto &game_data: scratch) {
+            for (const auto rotation: {RotationState::Right, RotationState::Left}) {
+                auto block = game_data.shadow_block;
+                auto rotation_state = game_data.current_block_rotation_state;
+                checksum += game_data.rotate(block, rotation_state, game_data.current_block_type, rotation, false);
+                checksum += static_cast<uint64_t>(block.anchor.x);
+            }
+        }
+        return checksum;
+    });
+
+    bench("refresh_shadow", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (auto &game_data: scratch) {
+            game_data.refresh_shadow();
+            checksum += static_cast<uint64_t>(game_data.shadow_block.anchor.y);
+        }
+        return checksum;
+    });
+
+    // clear_lines 会改场地，每次都要先恢复，单独测一下恢复的开销
+    bench("restore_board", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            restore_board(scratch[idx], pending[idx]);
+            checksum += scratch[idx].matrix[0];
+        }
+        return checksum;
+    });
+
+    bench("restore_board+clear_lines", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            restore_board(scratch[idx], pending[idx]);
+            checksum += scratch[idx].clear_lines();
+        }
+        return checksum;
+    });
+
+    bench("new_bag", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (auto &game_data: scratch) {
+            game_data.next_queue = {};
+            game_data.new_bag();
+            checksum += static_cast<uint64_t>(game_data.next_queue.front());
+        }
+        return checksum;
+    });
+
+    bench("new_block", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            auto &game_data = scratch[idx];
+            if (game_data.next_queue.empty()) {
+                game_data.next_queue = corpus[idx].next_queue;
+            }
+            game_data.new_block();
+            checksum += static_cast<uint64_t>(game_data.shadow_block.anchor.y);
+        }
+        return checksum;
+    });
+
+    // 回滚：存一份完整的模拟状态、放回去，以及放回去之后重新模拟一个预测窗口
+    std::vector<GameSnapshot> snapshots;
+    for (const auto &game_data: corpus) {
+        snapshots.push_back(game_data.save());
+    }
+    bench("save", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            snapshots[idx] = corpus[idx].save();
+            checksum += snapshots[idx].logical_frame_count;
+        }
+        return checksum;
+    });
+
+    bench("restore", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            scratch[idx].restore(snapshots[idx]);
+            checksum += static_cast<uint64_t>(scratch[idx].shadow_block.anchor.y);
+        }
+        return checksum;
+    });
+
+    bench("restore+step_x8", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        FrameInput input{};
+        input.set_key(InputKey::Left, false, true);
+        for (size_t idx = 0; idx < corpus.size(); idx++) {
+            scratch[idx].restore(snapshots[idx]);
+            for (size_t frame = 0; frame < RollbackPredictor::max_frames; frame++) {
+                scratch[idx].step(input);
+            }
+            checksum += static_cast<uint64_t>(scratch[idx].current_block.anchor.x);
+        }
+        return checksum;
+    });
+
+    // 和 Game::run 里一样：整个场地、当前方块和影子
+    bench("build_vertices", corpus.size(), [&] {
+        uint64_t checksum = 0;
+        for (const auto &game_data: corpus) {
+            for (size_t y = 0; y < matrix_height; y++) {
+                for (size_t x = 0; x < GameData::width; x++) {
+                    update_cell_vertices(vertices_matrix.data(), y * vertices_per_row + x * 6, origin, y, x,
+                                         block_colors[static_cast<size_t>(game_data.matrix_color[y][x])]);
+                }
+            }
+            for (size_t idx = 0; idx < game_data.current_block.points.size(); idx++) {
+                auto &[y, x] = game_data.current_block.points[idx];
+                update_cell_vertices(vertices_current_block.data(), idx * 6, origin, y, x,
+                                     block_colors[static_cast<size_t>(game_data.current_block_type)]);
+            }
+            for (size_t idx = 0; idx < game_data.shadow_block.points.size(); idx++) {
+                auto &[y, x] = game_data.shadow_block.points[idx];
+                update_cell_vertices(vertices_shadow_block.data(), idx * 6, origin, y, x,
+                                     sf::Color{255, 255, 255, 196});
+            }
+            checksum += static_cast<uint64_t>(vertices_matrix.back().position.x) + vertices_shadow_block[0].color.a;
+        }
+        return checksum;
+    });
+
+    std::println("{:<28}{:>12}{:>14}{:>14}", "benchmark", "ns/op", "allocs/op", "ops");
+    for (const auto &[name, ns_per_op, allocations_per_op, op_count]: results) {
+        std::println("{:<28}{:>12.2f}{:>14.3f}{:>14}", name, ns_per_op, allocations_per_op, op_count);
+    }
+    return 0;
+}
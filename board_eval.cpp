@@ -0,0 +1,211 @@
+#include "board_eval.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ZEETRIS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+/// MSVC 不需要 target 属性就能使用 AVX2 的内建函数
+#define ZEETRIS_TARGET_AVX2
+#else
+#define ZEETRIS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+
+namespace {
+    /// 每一行的 10 列
+    constexpr uint16_t full_row = GameData::full_row;
+    /// 相邻两列的比较只有 9 对
+    constexpr uint16_t pair_mask = full_row >> 1;
+    /// 把墙也算进去之后的 12 位：第 0 位是左墙，第 x + 1 位是第 x 列，第 11 位是右墙
+    constexpr uint16_t walls = 0b1000'0000'0001;
+    /// 行变换的 11 个间隔
+    constexpr uint16_t transition_mask = 0b0111'1111'1111;
+
+    /// 12 位以内的整数里 1 的个数。没有开 popcnt 指令时 std::popcount 是一次函数调用，查表要快得多
+    constexpr auto popcount_table = [] {
+        std::array<uint8_t, 1 << 12> table{};
+        for (size_t value = 0; value < table.size(); value++) {
+            table[value] = static_cast<uint8_t>(std::popcount(value));
+        }
+        return table;
+    }();
+
+    int16_t popcount12(const uint16_t value) { return popcount_table[value & 0x0fff]; }
+} // namespace
+
+void BoardBatch::reserve(const size_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    const auto new_capacity = std::max((capacity + lane_count - 1) / lane_count * lane_count, capacity_ * 2);
+
+    // 每一行的起点都变了，要逐行搬过去
+    std::vector<uint16_t> rows(row_count * new_capacity);
+    for (size_t y = 0; y < row_count; y++) {
+        std::copy_n(rows_.begin() + static_cast<ptrdiff_t>(y * capacity_), size_,
+                    rows.begin() + static_cast<ptrdiff_t>(y * new_capacity));
+    }
+    rows_ = std::move(rows);
+    features_.assign(board_feature_count * new_capacity, 0);
+    capacity_ = new_capacity;
+}
+
+size_t BoardBatch::push(const matrix_type &matrix) {
+    if (size_ == capacity_) {
+        reserve(size_ + 1);
+    }
+    for (size_t y = 0; y < row_count; y++) {
+        rows_[y * capacity_ + size_] = matrix[y];
+    }
+    return size_++;
+}
+
+void BoardBatch::evaluate(const bool allow_simd) {
+    size_t begin = 0;
+#ifdef ZEETRIS_X86
+    if (allow_simd && has_avx2()) {
+        // 容量是 lane_count 的整数倍，最后不满的一组也直接算，多出来的场地的结果不会被用到
+        begin = (size_ + lane_count - 1) / lane_count * lane_count;
+        evaluate_avx2_(0, begin);
+    }
+#endif
+    evaluate_scalar_(std::min(begin, size_), size_);
+}
+
+void BoardBatch::evaluate_scalar_(const size_t begin, const size_t end) {
+    // 也是一次一组，按行扫过去，这样访问 rows_ 是连续的
+    for (size_t base = begin; base < end; base += lane_count) {
+        const auto count = std::min(lane_count, end - base);
+        std::array<uint16_t, lane_count> covered{};
+        std::array<std::array<int16_t, lane_count>, board_feature_count> values{};
+        auto &[aggregate_height, max_height, holes, bumpiness, transitions, wells, near_complete] = values;
+
+        // 从上往下扫，covered 是这一行以及它上面所有行的并集，即“在最高点之下”的格子
+        for (auto y = static_cast<int32_t>(row_count) - 1; y >= 0; y--) {
+            const auto *rows = rows_.data() + static_cast<size_t>(y) * capacity_ + base;
+            for (size_t lane = 0; lane < count; lane++) {
+                const auto row = rows[lane];
+                auto &column_tops = covered[lane];
+                holes[lane] += popcount12(static_cast<uint16_t>(column_tops & ~row & full_row));
+                column_tops |= row;
+                aggregate_height[lane] += popcount12(column_tops);
+                max_height[lane] += column_tops != 0;
+                // 两列的高度差，就是恰好只有其中一列在最高点之下的行数
+                bumpiness[lane] +=
+                        popcount12(static_cast<uint16_t>((column_tops ^ (column_tops >> 1)) & pair_mask));
+                const auto walled = static_cast<uint16_t>((row << 1) | walls);
+                transitions[lane] += popcount12(static_cast<uint16_t>((walled ^ (walled >> 1)) & transition_mask));
+                wells[lane] += popcount12(static_cast<uint16_t>(~column_tops & walled & (walled >> 2) & full_row));
+                near_complete[lane] += popcount12(row) == GameData::width - 1;
+            }
+        }
+
+        for (size_t feature = 0; feature < board_feature_count; feature++) {
+            std::copy_n(values[feature].begin(), count,
+                        features_.begin() + static_cast<ptrdiff_t>(feature * capacity_ + base));
+        }
+    }
+}
+
+#ifdef ZEETRIS_X86
+namespace {
+    /// 每个 16 位整数里 1 的个数。先用 pshufb 查表求出每 4 位的，再把一个 16 位整数里的两个字节加起来。
+    ZEETRIS_TARGET_AVX2 __m256i popcount16(const __m256i value) {
+        const auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+                                            2, 2, 3, 2, 3, 3, 4);
+        const auto low_nibbles = _mm256_set1_epi8(0x0f);
+        const auto counts = _mm256_add_epi8(
+                _mm256_shuffle_epi8(table, _mm256_and_si256(value, low_nibbles)),
+                _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(value, 4), low_nibbles)));
+        return _mm256_add_epi16(_mm256_and_si256(counts, _mm256_set1_epi16(0xff)), _mm256_srli_epi16(counts, 8));
+    }
+} // namespace
+
+ZEETRIS_TARGET_AVX2 void BoardBatch::evaluate_avx2_(const size_t begin, const size_t end) {
+    const auto zero = _mm256_setzero_si256();
+    const auto one = _mm256_set1_epi16(1);
+    const auto full = _mm256_set1_epi16(static_cast<int16_t>(full_row));
+    const auto pairs = _mm256_set1_epi16(static_cast<int16_t>(pair_mask));
+    const auto wall_bits = _mm256_set1_epi16(static_cast<int16_t>(walls));
+    const auto transition_bits = _mm256_set1_epi16(static_cast<int16_t>(transition_mask));
+    const auto near_complete_count = _mm256_set1_epi16(GameData::width - 1);
+
+    for (size_t base = begin; base < end; base += lane_count) {
+        // 和 evaluate_scalar_() 一模一样，只是一次算 16 个场地
+        auto covered = zero, aggregate_height = zero, max_height = zero, holes = zero, bumpiness = zero,
+             transitions = zero, wells = zero, near_complete = zero;
+        for (auto y = static_cast<int32_t>(row_count) - 1; y >= 0; y--) {
+            const auto row = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(rows_.data() + static_cast<size_t>(y) * capacity_ + base));
+            holes = _mm256_add_epi16(holes, popcount16(_mm256_and_si256(_mm256_andnot_si256(row, covered), full)));
+            covered = _mm256_or_si256(covered, row);
+            aggregate_height = _mm256_add_epi16(aggregate_height, popcount16(covered));
+            // cmpeq 得到的是 -1，加上 1 正好是 covered != 0
+            max_height = _mm256_add_epi16(max_height, _mm256_add_epi16(one, _mm256_cmpeq_epi16(covered, zero)));
+            bumpiness = _mm256_add_epi16(
+                    bumpiness,
+                    popcount16(_mm256_and_si256(_mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1)), pairs)));
+            const auto walled = _mm256_or_si256(_mm256_slli_epi16(row, 1), wall_bits);
+            transitions = _mm256_add_epi16(
+                    transitions, popcount16(_mm256_and_si256(_mm256_xor_si256(walled, _mm256_srli_epi16(walled, 1)),
+                                                             transition_bits)));
+            wells = _mm256_add_epi16(
+                    wells, popcount16(_mm256_andnot_si256(
+                                   covered, _mm256_and_si256(_mm256_and_si256(walled, _mm256_srli_epi16(walled, 2)),
+                                                             full))));
+            near_complete = _mm256_sub_epi16(near_complete, _mm256_cmpeq_epi16(popcount16(row), near_complete_count));
+        }
+
+        // 按 BoardFeature 的顺序
+        const std::array values{aggregate_height, max_height, holes, bumpiness, transitions, wells, near_complete};
+        for (size_t feature = 0; feature < board_feature_count; feature++) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(features_.data() + feature * capacity_ + base),
+                                values[feature]);
+        }
+    }
+}
+#else
+void BoardBatch::evaluate_avx2_(const size_t begin, const size_t end) { evaluate_scalar_(begin, end); }
+#endif
+
+void BoardBatch::score(const BoardWeights &weights, std::vector<float> &scores) const {
+    scores.assign(size_, 0.f);
+    // 按特征一行一行地累加，每一行都是连续的，编译器可以自动向量化
+    for (size_t feature = 0; feature < board_feature_count; feature++) {
+        if (weights[feature] == 0.f) {
+            continue;
+        }
+        const auto *values = features_.data() + feature * capacity_;
+        for (size_t idx = 0; idx < size_; idx++) {
+            scores[idx] += weights[feature] * static_cast<float>(values[idx]);
+        }
+    }
+}
+
+bool BoardBatch::has_avx2() {
+#if defined(ZEETRIS_X86) && defined(_MSC_VER)
+    static const bool supported = [] {
+        std::array<int, 4> info{};
+        __cpuid(info.data(), 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info.data(), 1);
+        // 还要操作系统保存了 YMM 寄存器
+        const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0b110) == 0b110;
+        __cpuidex(info.data(), 7, 0);
+        return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#elif defined(ZEETRIS_X86)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,114 @@
+#ifndef BOARD_EVAL_H
+#define BOARD_EVAL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "game_data.h"
+
+
+/// 场地特征。
+enum class BoardFeature : uint8_t {
+    /// 所有列的高度之和
+    AggregateHeight = 0,
+    /// 最高的一列的高度
+    MaxHeight,
+    /// 空洞数，即上面有方块盖着的空格子
+    Holes,
+    /// 凹凸度，即相邻两列的高度差之和
+    Bumpiness,
+    /// 行变换数，即每一行中从有方块到没有方块（或者反过来）的次数，两边的墙算有方块
+    RowTransitions,
+    /// 井的格子数，即在所在列的最高点之上、左右两边都有方块（或墙）的空格子
+    Wells,
+    /// 只差一格就能消除的行数
+    NearCompleteRows,
+};
+
+/// 场地特征的个数
+static constexpr size_t board_feature_count = 7;
+
+/// 每个场地特征的权重，按 BoardFeature 编号。
+using BoardWeights = std::array<float, board_feature_count>;
+
+/// 默认的权重。
+static constexpr BoardWeights default_board_weights{
+        -0.510066f, // AggregateHeight
+        0.f,        // MaxHeight
+        -0.35663f,  // Holes
+        -0.184483f, // Bumpiness
+        0.f,        // RowTransitions
+        0.f,        // Wells
+        0.f,        // NearCompleteRows
+};
+
+/// 一批待评估的场地。
+///
+/// 场地按结构体数组（SoA）存储：所有场地的第 y 行连续地放在一起，这样一条 AVX2 指令可以同时处理 16 个场地的同一行。
+/// 算出来的特征也是同样的布局。CPU 支持 AVX2 时用 AVX2 计算，否则用标量代码，两者的结果完全一致。
+///
+/// clear() 不会释放内存，同一个 BoardBatch 反复使用时不会分配内存。
+class BoardBatch {
+public:
+    /// 占用位图
+    using matrix_type = decltype(GameData::matrix);
+
+    /// 行数
+    static constexpr size_t row_count = std::tuple_size_v<matrix_type>;
+    /// 一次处理的场地个数，容量总是它的整数倍
+    static constexpr size_t lane_count = 16;
+
+private:
+    /// 场地个数
+    size_t size_{};
+    /// 容量
+    size_t capacity_{};
+    /// 第 y 行、第 idx 个场地在 rows_[y * capacity_ + idx]
+    std::vector<uint16_t> rows_;
+    /// 第 feature 个特征、第 idx 个场地在 features_[feature * capacity_ + idx]
+    std::vector<int16_t> features_;
+
+    /// 逐个场地计算 [begin, end) 的特征。
+    void evaluate_scalar_(size_t begin, size_t end);
+
+    /// 用 AVX2 计算 [begin, end) 的特征，begin 和 end 都是 lane_count 的整数倍。
+    void evaluate_avx2_(size_t begin, size_t end);
+
+public:
+    BoardBatch() = default;
+
+    /// 清空，但是保留容量。
+    void clear() { size_ = 0; }
+
+    /// 预留至少能放下 capacity 个场地的空间。
+    void reserve(size_t capacity);
+
+    /// 场地个数。
+    [[nodiscard]] size_t size() const { return size_; }
+
+    /// 追加一个场地。
+    /// @return 它的下标
+    size_t push(const matrix_type &matrix);
+
+    /// 计算所有场地的特征。
+    /// @param allow_simd 为 false 时强制使用标量代码
+    void evaluate(bool allow_simd = true);
+
+    /// 第 idx 个场地的某个特征，要先 evaluate()。
+    [[nodiscard]] int16_t feature(size_t idx, BoardFeature feature) const {
+        return features_[static_cast<size_t>(feature) * capacity_ + idx];
+    }
+
+    /// 按权重算出所有场地的评分，越大越好，要先 evaluate()。
+    /// @param weights 权重
+    /// @param scores 评分，会被调整成 size() 大小
+    void score(const BoardWeights &weights, std::vector<float> &scores) const;
+
+    /// CPU 是否支持 AVX2。
+    [[nodiscard]] static bool has_avx2();
+};
+
+
+#endif // BOARD_EVAL_H
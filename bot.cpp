@@ -0,0 +1,311 @@
+#include "bot.h"
+
+#include <algorithm>
+#include <memory>
+#include <span>
+
+#include "zobrist.h"
+
+
+namespace {
+    using matrix_type = MoveGenerator::matrix_type;
+
+    /// 集束搜索中的一个局面。
+    class search_node {
+    public:
+        /// 占用位图
+        matrix_type matrix;
+        /// 接下来要放的方块，None 表示预览块已经用完了
+        BlockType current_block_type;
+        /// 暂存块
+        BlockType hold_block_type;
+        /// 下一个要从预览序列里拿的方块的下标
+        uint8_t queue_position;
+        /// 这个局面是从根的第几个落点展开来的
+        uint16_t root_index;
+        /// 一路上消行得到的奖励
+        float reward;
+        /// 用来排序的评分，即 reward 加上对当前场地的评估
+        float score;
+        /// matrix 的 Zobrist 哈希，随着放块、消行增量地维护
+        uint64_t matrix_hash;
+        /// 一路上的连击和 B2B，决定之后的攻击
+        ScoreState score_state;
+
+        /// 整个局面的哈希，用来把可能相同的局面排在一起。queue_position 不在里面，真正比较时再看。
+        [[nodiscard]] uint64_t hash() const {
+            return matrix_hash ^ Zobrist::hold(hold_block_type, false) ^ Zobrist::queue_head(current_block_type);
+        }
+
+        /// 是否和 other 是同一个局面，不看评分和它是从哪个落点展开来的。
+        [[nodiscard]] bool same_position(const search_node &other) const {
+            return matrix_hash == other.matrix_hash && current_block_type == other.current_block_type &&
+                   hold_block_type == other.hold_block_type && queue_position == other.queue_position &&
+                   score_state.combo == other.score_state.combo &&
+                   score_state.back_to_back == other.score_state.back_to_back && matrix == other.matrix;
+        }
+    };
+
+    /// 每个线程自己的移动生成器。
+    MoveGenerator &local_generator() {
+        thread_local MoveGenerator generator;
+        return generator;
+    }
+
+    /// 每个线程自己的一批待评估的场地。
+    BoardBatch &local_batch() {
+        thread_local BoardBatch batch;
+        return batch;
+    }
+
+    /// 每个线程自己的评分缓冲区。
+    std::vector<float> &local_scores() {
+        thread_local std::vector<float> scores;
+        return scores;
+    }
+
+    /// 消行，同时更新哈希，返回消除的行数。
+    int32_t clear_lines(matrix_type &matrix, uint64_t &matrix_hash) {
+        int32_t count = 0;
+        for (size_t y = 0; y < matrix.size(); y++) {
+            if (matrix[y] == GameData::full_row) {
+                matrix_hash ^= Zobrist::row(y, matrix[y]);
+                count++;
+            } else if (count != 0) {
+                matrix_hash ^= Zobrist::row(y, matrix[y]) ^ Zobrist::row(y - count, matrix[y]);
+                matrix[y - count] = matrix[y];
+            }
+        }
+        std::fill(matrix.end() - count, matrix.end(), uint16_t{0});
+        return count;
+    }
+
+    /// 在 node 上放下一个落点，得到子局面。子局面的 score 只包含 reward，场地的评估要之后成批地加上。
+    search_node apply(const search_node &node, const Placement &placement, const std::vector<BlockType> &queue,
+                      const BotConfig &config) {
+        search_node child = node;
+        if (placement.use_hold) {
+            child.hold_block_type = node.current_block_type;
+            if (node.hold_block_type == BlockType::None) {
+                // 暂存块本来是空的，放下的是预览序列里的下一个
+                child.queue_position++;
+            }
+        }
+
+        // 落点记着最后一步能不能是旋转，perform() 照着 path() 放下时游戏里的判定也是这样
+        const auto spin = GameData::detect_spin(node.matrix, placement.block_type, placement.rotation_state,
+                                                placement.anchor, placement.last_rotation_kick);
+
+        for (const auto &[y, x]: placement.to_block().points) {
+            child.matrix[y] |= static_cast<uint16_t>(1u << x);
+            child.matrix_hash ^= Zobrist::cell(y, x);
+        }
+        const auto lines = clear_lines(child.matrix, child.matrix_hash);
+        const auto perfect_clear = lines > 0 && std::ranges::all_of(child.matrix, [](const uint16_t row) {
+            return row == 0;
+        });
+        // 分数用不到，等级随便给一个
+        const auto event = child.score_state.lock({static_cast<uint32_t>(lines), spin, perfect_clear}, 1);
+        child.reward += config.line_reward * static_cast<float>(lines) +
+                        config.attack_reward * static_cast<float>(event.attack);
+        child.current_block_type = BlockType::None;
+        if (child.queue_position < queue.size()) {
+            child.current_block_type = queue[child.queue_position++];
+        }
+        child.score = child.reward;
+        return child;
+    }
+
+    /// 去掉重复的局面，同一个局面只留评分最高的那个。
+    ///
+    /// 换个顺序放同样的几块（先放 I 再放 O 和先放 O 再放 I）经常得到同一个局面，不去重的话集束里会挤满
+    /// 同一个局面的副本，真正不同的局面反而被挤掉了。评分一样时留 root_index 小的，结果和线程的调度无关。
+    void remove_transpositions(std::vector<search_node> &nodes) {
+        std::ranges::sort(nodes, [](const search_node &lhs, const search_node &rhs) {
+            const auto lhs_hash = lhs.hash();
+            const auto rhs_hash = rhs.hash();
+            if (lhs_hash != rhs_hash) {
+                return lhs_hash < rhs_hash;
+            }
+            if (lhs.score != rhs.score) {
+                return lhs.score > rhs.score;
+            }
+            return lhs.root_index < rhs.root_index;
+        });
+        const auto [first, last] = std::ranges::unique(
+                nodes, [](const search_node &lhs, const search_node &rhs) { return lhs.same_position(rhs); });
+        nodes.erase(first, last);
+    }
+
+    /// 成批地评估这些局面的场地，把评估加到各自的 score 上。
+    void evaluate(const std::span<search_node> nodes, const BotConfig &config) {
+        auto &batch = local_batch();
+        auto &scores = local_scores();
+        batch.clear();
+        for (const auto &node: nodes) {
+            batch.push(node.matrix);
+        }
+        batch.evaluate();
+        batch.score(config.weights, scores);
+        for (size_t idx = 0; idx < nodes.size(); idx++) {
+            nodes[idx].score += scores[idx];
+        }
+    }
+} // namespace
+
+Bot::Bot(BotConfig config, const size_t thread_count) :
+    config_(config), thread_pool_(thread_count), search_thread_([this] { search_loop_(); }) {}
+
+Bot::~Bot() {
+    {
+        std::lock_guard guard(request_mutex_);
+        quit_ = true;
+        request_generation_++;
+    }
+    request_condition_.notify_all();
+    search_thread_.join();
+}
+
+void Bot::think(const GameData &game_data, const std::chrono::steady_clock::time_point deadline) {
+    {
+        std::lock_guard guard(request_mutex_);
+        request_.emplace(game_data, deadline);
+        request_generation_++;
+    }
+    request_condition_.notify_one();
+}
+
+std::optional<BotMove> Bot::best(const size_t piece_id) {
+    const std::unique_lock lock(result_mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || !result_.has_value() || result_->piece_id != piece_id) {
+        return std::nullopt;
+    }
+    return result_;
+}
+
+void Bot::search_loop_() {
+    while (true) {
+        std::optional<request> current;
+        size_t generation;
+        {
+            std::unique_lock lock(request_mutex_);
+            request_condition_.wait(lock, [this] { return quit_ || request_.has_value(); });
+            if (quit_) {
+                return;
+            }
+            current = std::move(request_);
+            request_.reset();
+            generation = request_generation_;
+        }
+
+        search(
+                current->game_data, current->deadline, &thread_pool_, config_,
+                [this](const BotMove &move) {
+                    std::lock_guard guard(result_mutex_);
+                    result_ = move;
+                },
+                [this, generation] { return request_generation_ != generation; });
+    }
+}
+
+std::optional<BotMove> Bot::search(const GameData &game_data, const std::chrono::steady_clock::time_point deadline,
+                                   ThreadPool *thread_pool, const BotConfig &config,
+                                   const std::function<void(const BotMove &)> &on_depth,
+                                   const std::function<bool()> &should_stop) {
+    const auto stopped = [&] {
+        return std::chrono::steady_clock::now() >= deadline || (should_stop && should_stop());
+    };
+
+    std::vector<BlockType> queue;
+    for (size_t idx = 0; idx < game_data.next_queue.size() && idx < config.preview_count; idx++) {
+        queue.push_back(game_data.next_queue[idx]);
+    }
+
+    // 根的落点单独用一个生成器，之后还要用它还原操作序列
+    const auto root_generator = std::make_unique<MoveGenerator>();
+    const auto root_placements = root_generator->generate(game_data);
+    if (root_placements.empty()) {
+        return std::nullopt;
+    }
+
+    const search_node root{game_data.matrix, game_data.current_block_type, game_data.hold_block_type, 0, 0, 0.f,
+                           0.f, game_data.matrix_hash, game_data.score_state};
+    std::vector<search_node> layer;
+    layer.reserve(root_placements.size());
+    for (size_t idx = 0; idx < root_placements.size(); idx++) {
+        layer.push_back(apply(root, root_placements[idx], queue, config));
+        layer.back().root_index = static_cast<uint16_t>(idx);
+    }
+    evaluate(layer, config);
+    remove_transpositions(layer);
+
+    std::optional<BotMove> best;
+    std::vector<std::vector<search_node>> children;
+    for (size_t depth = 1;; depth++) {
+        // 只留下最好的 beam_width 个
+        if (layer.size() > config.beam_width) {
+            std::ranges::nth_element(layer, layer.begin() + static_cast<ptrdiff_t>(config.beam_width),
+                                     std::ranges::greater{}, &search_node::score);
+            layer.resize(config.beam_width);
+        }
+
+        const auto &leader = *std::ranges::max_element(layer, {}, &search_node::score);
+        const auto &placement = root_placements[leader.root_index];
+        best = BotMove{game_data.piece_count, placement, root_generator->path(placement), depth, leader.score};
+        if (on_depth) {
+            on_depth(*best);
+        }
+
+        if (stopped()) {
+            break;
+        }
+
+        // 展开下一层。每个局面的子局面写到自己的格子里，展开完再合起来
+        children.resize(layer.size());
+        std::atomic_bool aborted{false};
+        const auto expand = [&](const size_t idx) {
+            auto &result = children[idx];
+            result.clear();
+            const auto &node = layer[idx];
+            if (node.current_block_type == BlockType::None || aborted) {
+                return;
+            }
+            if (stopped()) {
+                aborted = true;
+                return;
+            }
+            auto hold_block_type = node.hold_block_type;
+            if (hold_block_type == BlockType::None && node.queue_position < queue.size()) {
+                hold_block_type = queue[node.queue_position];
+            }
+            for (const auto &child_placement:
+                 local_generator().generate(node.matrix, node.current_block_type, hold_block_type)) {
+                result.push_back(apply(node, child_placement, queue, config));
+            }
+            evaluate(result, config);
+        };
+        if (thread_pool != nullptr) {
+            thread_pool->parallel_for(layer.size(), expand);
+        } else {
+            for (size_t idx = 0; idx < layer.size(); idx++) {
+                expand(idx);
+            }
+        }
+        if (aborted) {
+            break;
+        }
+
+        std::vector<search_node> next_layer;
+        for (auto &result: children) {
+            next_layer.insert(next_layer.end(), result.begin(), result.end());
+        }
+        if (next_layer.empty()) {
+            // 预览块用完了，或者已经无处可放了
+            break;
+        }
+        remove_transpositions(next_layer);
+        layer = std::move(next_layer);
+    }
+
+    return best;
+}
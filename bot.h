@@ -0,0 +1,120 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "board_eval.h"
+#include "game_data.h"
+#include "move_generator.h"
+#include "thread_pool.h"
+
+
+/// 机器人的设置
+class BotConfig {
+public:
+    /// 集束搜索每一层保留的局面数
+    size_t beam_width = 512;
+    /// 最多看几个预览块
+    size_t preview_count = 5;
+    /// 场地特征的权重
+    BoardWeights weights = default_board_weights;
+    /// 每消一行的奖励
+    float line_reward = 0.760666f;
+    /// 每一行攻击（T-spin、B2B、连击、全消都算在里面）额外的奖励
+    float attack_reward = 0.25f;
+};
+
+/// 机器人给出的一步。
+class BotMove {
+public:
+    /// 这一步是给第几个方块的，即请求时的 GameData::piece_count
+    size_t piece_id;
+    /// 要放到的落点
+    Placement placement;
+    /// 到达落点的操作序列，之后硬降即可
+    std::vector<Move> path;
+    /// 搜索到的深度
+    size_t depth;
+    /// 这一步的评分
+    float score;
+};
+
+/// 机器人。在后台对 GameData 做集束搜索，搜索的每一层都在线程池上并行展开。
+///
+/// 搜索是随时可停的：每搜完一层就更新一次最好的一步，所以到了放置的时候手上总有一步可以用。
+/// 提交局面和取结果都只会短暂地持有锁（取结果时只会 try_lock），不会卡住逻辑线程。
+class Bot {
+    /// 一次搜索请求
+    class request {
+    public:
+        /// 要搜索的局面
+        GameData game_data;
+        /// 搜索的截止时间
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /// 设置
+    BotConfig config_;
+    /// 用来并行展开的线程池
+    ThreadPool thread_pool_;
+
+    /// 最新的请求
+    std::optional<request> request_;
+    /// 请求的序号，每次提交新请求都会自增，用来打断旧的搜索
+    std::atomic_size_t request_generation_{};
+    std::mutex request_mutex_;
+    std::condition_variable request_condition_;
+
+    /// 目前最好的一步
+    std::optional<BotMove> result_;
+    std::mutex result_mutex_;
+
+    /// 指示搜索线程退出
+    bool quit_{false};
+    /// 搜索线程
+    std::thread search_thread_;
+
+    /// 搜索线程的主循环。
+    void search_loop_();
+
+public:
+    /// @param config 设置
+    /// @param thread_count 线程池的线程数，不填就是硬件线程数
+    explicit Bot(BotConfig config = {}, size_t thread_count = std::thread::hardware_concurrency());
+    Bot(const Bot &) = delete;
+    Bot &operator=(const Bot &) = delete;
+    ~Bot();
+
+    /// 提交一个局面，后台马上开始搜索，之前的搜索会被打断。
+    /// @param game_data 要搜索的局面
+    /// @param deadline 搜索的截止时间
+    void think(const GameData &game_data, std::chrono::steady_clock::time_point deadline);
+
+    /// 取出目前最好的一步，不会阻塞。
+    /// @param piece_id 要的是给第几个方块的，即请求时的 GameData::piece_count
+    /// @return 没有这个方块的结果，或者结果正在被更新的时候，返回 nullopt
+    [[nodiscard]] std::optional<BotMove> best(size_t piece_id);
+
+    /// 在调用线程上同步地搜索，用于无头模拟。
+    /// @param game_data 要搜索的局面
+    /// @param deadline 搜索的截止时间
+    /// @param thread_pool 用来并行展开的线程池，为空时在调用线程上串行展开
+    /// @param config 设置
+    /// @param on_depth 每搜完一层都会用这一层最好的一步调用它
+    /// @param should_stop 返回 true 时放弃还没搜完的一层
+    /// @return 最好的一步；当前局面无处可放时返回 nullopt
+    static std::optional<BotMove> search(const GameData &game_data, std::chrono::steady_clock::time_point deadline,
+                                         ThreadPool *thread_pool, const BotConfig &config,
+                                         const std::function<void(const BotMove &)> &on_depth = {},
+                                         const std::function<bool()> &should_stop = {});
+};
+
+
+#endif // BOT_H
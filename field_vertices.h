@@ -0,0 +1,119 @@
+#ifndef FIELD_VERTICES_H
+#define FIELD_VERTICES_H
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "game_data.h"
+
+
+/// 预设值，表示一种方块对应的颜色值，以 block_colors[方块类型] 的方式访问。
+static const std::array block_colors{
+        sf::Color::Transparent, // None
+        sf::Color::Cyan, // I
+        sf::Color::Blue, // J
+        sf::Color{225, 127, 0}, // L
+        sf::Color::Yellow, // O
+        sf::Color::Green, // S
+        sf::Color::Red, // Z
+        sf::Color{128, 0, 128}, // T
+        sf::Color{128, 128, 128}, // Garbage
+};
+
+/// 场地左上角在窗口中的位置，使场地居中。
+/// @param screen_size 窗口大小
+/// @return 场地左上角的坐标
+inline sf::Vector2f field_origin(const sf::Vector2u screen_size) {
+    return {static_cast<float>(screen_size.x) / 2.f -
+                    static_cast<float>(GameData::width) / 2.f * GameConfig::block_size,
+            static_cast<float>(screen_size.y) / 2.f -
+                    static_cast<float>(GameData::height_main) / 2.f * GameConfig::block_size};
+}
+
+/// 把一个矩形写成两个三角形，即 begin[offset] 到 begin[offset + 5]。只写位置和颜色，不动纹理坐标。
+/// @param begin 顶点数组
+/// @param offset 这个矩形的第一个顶点的下标
+/// @param top_left 左上角的坐标
+/// @param size 大小
+/// @param color 颜色
+inline void update_quad_vertices(sf::Vertex *begin, const size_t offset, const sf::Vector2f top_left,
+                                 const sf::Vector2f size, const sf::Color color) {
+    const auto left = top_left.x;
+    const auto right = top_left.x + size.x;
+    const auto top = top_left.y;
+    const auto bottom = top_left.y + size.y;
+
+    begin[offset + 0].position = sf::Vector2f{left, top};
+    begin[offset + 1].position = sf::Vector2f{left, bottom};
+    begin[offset + 2].position = sf::Vector2f{right, top};
+
+    begin[offset + 3].position = sf::Vector2f{right, top};
+    begin[offset + 4].position = sf::Vector2f{left, bottom};
+    begin[offset + 5].position = sf::Vector2f{right, bottom};
+
+    for (size_t idx = offset; idx < offset + 6; idx++) {
+        begin[idx].color = color;
+    }
+}
+
+/// 把场地中的一格写成两个三角形，即 begin[offset] 到 begin[offset + 5]。
+/// @param begin 顶点数组
+/// @param offset 这一格的第一个顶点的下标
+/// @param origin 场地左上角的坐标，见 field_origin()
+/// @param position_y 格子的 y
+/// @param position_x 格子的 x
+/// @param color 颜色
+inline void update_cell_vertices(sf::Vertex *begin, const size_t offset, const sf::Vector2f origin,
+                                 const size_t position_y, const size_t position_x, const sf::Color color) {
+    const auto y = static_cast<int32_t>(position_y);
+    const auto x = static_cast<int32_t>(position_x);
+
+    // 注意这里 sf::Vector2f 先是 x 再是 y 的，和项目里通行的记法正好相反
+    const auto left = static_cast<float>(x) * GameConfig::block_size + origin.x;
+    const auto top = static_cast<float>(GameData::height_main - y - 1) * GameConfig::block_size + origin.y;
+    update_quad_vertices(begin, offset, {left, top}, {GameConfig::block_size, GameConfig::block_size}, color);
+}
+
+/// 把一个单独显示的方块（暂存块、预览块）写成 4 个格子，即 begin[offset] 到 begin[offset + 23]。
+/// 方块取初始的旋转状态，在 4 格宽、2 格高的框里居中。
+/// @param begin 顶点数组
+/// @param offset 第一个格子的第一个顶点的下标
+/// @param top_left 框的左上角的坐标
+/// @param cell_size 一格的大小
+/// @param block_type 方块类型，None 的时候什么都不画
+/// @param color 不为空时用这个颜色，而不是方块本来的颜色
+inline void update_preview_vertices(sf::Vertex *begin, const size_t offset, const sf::Vector2f top_left,
+                                    const float cell_size, const BlockType block_type,
+                                    const std::optional<sf::Color> color = std::nullopt) {
+    if (block_type == BlockType::None) {
+        for (size_t idx = 0; idx < 4; idx++) {
+            update_quad_vertices(begin, offset + idx * 6, top_left, {}, sf::Color::Transparent);
+        }
+        return;
+    }
+
+    const auto &block_shape = block_shapes[static_cast<size_t>(block_type)][0];
+    auto min_y = block_shape[0].y, max_y = block_shape[0].y, min_x = block_shape[0].x, max_x = block_shape[0].x;
+    for (const auto &[y, x]: block_shape) {
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+    }
+    // 框比方块大出来的部分两边平分
+    const auto margin_x = static_cast<float>(4 - (max_x - min_x + 1)) / 2.f;
+    const auto margin_y = static_cast<float>(2 - (max_y - min_y + 1)) / 2.f;
+    for (size_t idx = 0; idx < 4; idx++) {
+        const auto [y, x] = block_shape[idx];
+        update_quad_vertices(begin, offset + idx * 6,
+                             {top_left.x + (static_cast<float>(x - min_x) + margin_x) * cell_size,
+                              top_left.y + (static_cast<float>(max_y - y) + margin_y) * cell_size},
+                             {cell_size, cell_size}, color.value_or(block_colors[static_cast<size_t>(block_type)]));
+    }
+}
+
+#endif // FIELD_VERTICES_H
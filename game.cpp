@@ -1,485 +1,498 @@
 #include "game.h"
 
 #include <algorithm>
+#include <bit>
 #include <boost/bind.hpp>
+#include <filesystem>
 #include <print>
 #include <random>
 #include <ranges>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 
-
-bool block::operator==(const block &block) const {
-    return this->points == block.points && this->anchor == block.anchor;
-}
-
-kickwall *get_kickwall(const BlockType block_type) {
-    switch (block_type) {
-        case BlockType::I:
-            return &kickwall_I;
-        case BlockType::O:
-            return &kickwall_O;
-        case BlockType::None:
-        case BlockType::Unknown:
-            throw std::invalid_argument("Invalid block type");
-        default:
-            return &kickwall_JLSTZ;
-    }
-}
-
-bool GameData::move(block &block, const point<int32_t> offset, const bool refresh_shadow) {
-    temp_block = block;
-    for (auto &[y, x]: block.points) {
-        y += offset.y;
-        x += offset.x;
-    }
-    block.anchor.y += offset.y;
-    block.anchor.x += offset.x;
-    if (!check(block)) {
-        block = temp_block;
-        return false;
-    }
-    if (refresh_shadow) {
-        this->refresh_shadow();
+#include "profiler.h"
+#include "render_batch.h"
+#include "tick_log.h"
+
+
+Game::Game(sf::RenderWindow *render_window, std::shared_ptr<sf::Font> font, const bool use_bot,
+           std::optional<VersusEndpoint> versus_endpoint, const std::optional<uint16_t> spectator_port) :
+    versus_endpoint_(std::move(versus_endpoint)), spectator_port_(spectator_port) {
+    // random_device 一次只给 32 位，拼成 64 位的种子
+    std::random_device random_device;
+    const auto seed = static_cast<uint64_t>(random_device()) << 32 | random_device();
+    game_data_ = std::make_shared<GameData>(seed);
+    replay_ = Replay{seed};
+    if (use_bot) {
+        bot_ = std::make_unique<Bot>();
+        bot_move_generator_ = std::make_unique<MoveGenerator>();
     }
-    return true;
+    keyboard_ = std::make_shared<Keyboard>();
+    font_ = std::move(font);
+    render_window_ = render_window;
 }
 
-bool GameData::rotate(block &block, RotationState &block_rotation_state, const BlockType block_type,
-                      const RotationState rotation, const bool refresh_shadow) {
-    auto [center_y, center_x] = rotating_centers[block_type];
-    center_y += static_cast<float>(block.anchor.y);
-    center_x += static_cast<float>(block.anchor.x);
-
-    temp_block = block;
-
-    for (auto &[y, x]: block.points) {
-        // 致敬经典
-        const float tmp_y = static_cast<float>(x) - center_x;
-        const float tmp_x = static_cast<float>(y) - center_y;
-        switch (rotation) {
-            case RotationState::Left:
-                y = static_cast<int32_t>(center_y + tmp_y);
-                x = static_cast<int32_t>(center_x - tmp_x);
-                break;
-            case RotationState::Right:
-                y = static_cast<int32_t>(center_y - tmp_y);
-                x = static_cast<int32_t>(center_x + tmp_x);
-                break;
-            default:
-                throw std::invalid_argument("Invalid rotation type");
+void Game::logic_frame([[maybe_unused]] const boost::system::error_code &error_code,
+                       boost::asio::steady_timer *timer, std::atomic_flag *flag_thread_quit) {
+    const auto now = TickScheduler::clock::now();
+    if (const auto tick_count = tick_scheduler_.begin_wakeup(now); tick_count != 0) {
+        for (size_t idx = 0; idx < tick_count; idx++) {
+            tick_();
         }
+        tick_scheduler_.end_wakeup(now, TickScheduler::clock::now());
     }
 
-    RotationState new_state = block_rotation_state;
-
-    switch (rotation) {
-        case RotationState::Left:
-            new_state = static_cast<RotationState>((static_cast<int>(new_state) + 3) % 4);
-            break;
-        case RotationState::Right:
-            new_state = static_cast<RotationState>((static_cast<int>(new_state) + 1) % 4);
-        default:
-            break;
-    }
-
-    const auto temp_rotated_block = block;
-
-    for (auto &list_offset = get_kickwall(block_type)->at(std::pair{block_rotation_state, new_state});
-         auto &[offset_x, offset_y]: list_offset) {
-        for (auto &[block_y, block_x]: block.points) {
-            block_y += offset_y;
-            block_x += offset_x;
+    if (flag_thread_quit->test()) {
+        // 连接上还挂着读，不断开的话 io_context 不会退出
+        if (versus_connection_) {
+            versus_connection_->close();
         }
-
-        if (check(block)) {
-            block.anchor.y += offset_y;
-            block.anchor.x += offset_x;
-            goto success;
+        if (spectator_server_) {
+            spectator_server_->close();
         }
-
-        block = temp_rotated_block;
+        return;
     }
 
-    block = temp_block;
-    return false;
-success:
-    block_rotation_state = new_state;
-    if (refresh_shadow) {
-        this->refresh_shadow();
-    }
-    return true;
+    // 等到下一帧的绝对截止时间，而不是从现在往后推一个周期，这样误差不会累积
+    timer->expires_at(tick_scheduler_.next_deadline());
+    timer->async_wait(boost::bind(&Game::logic_frame, this, boost::asio::placeholders::error, timer, flag_thread_quit));
 }
 
-void GameData::new_bag(std::mt19937 &rng, const size_t bag_count) {
-    for (size_t i = 0; i < bag_count; i++) {
-        std::vector list{BlockType::I, BlockType::J, BlockType::L, BlockType::O,
-                         BlockType::S, BlockType::Z, BlockType::T};
-        std::ranges::shuffle(list, rng);
-        next_queue.append_range(list);
-    }
-}
+void Game::tick_() {
+    ZEETRIS_PROFILE_SCOPE("tick");
 
-void GameData::new_block(const BlockType block_type) {
-    BlockType type;
-    [[likely]]
-    if (block_type == BlockType::None) {
-        if (next_queue.empty()) {
-            // 连预览块都不给我，我怎么生成啊？
-            throw std::runtime_error("Member `next_queue` is empty.");
+    FrameInput input{};
+    {
+        ZEETRIS_PROFILE_SCOPE("tick.input");
+        // 取出上一帧以来的所有按键事件，不需要加锁
+        keyboard_->update();
+        for (size_t key = 0; key < key_bindings.size(); key++) {
+            input.set_key(static_cast<InputKey>(key), keyboard_->is_key_pressed(key_bindings[key]),
+                          keyboard_->is_key_pressing(key_bindings[key]));
         }
-        type = next_queue.front();
-        next_queue.pop_front();
-    } else {
-        type = block_type;
     }
 
-    current_block = blocks[static_cast<size_t>(type)];
-    for (auto &[y, x]: current_block.points) {
-        y += 20;
-        x += 3;
+    if (versus_connection_ && !versus_connection_->connected()) {
+        if (!versus_connection_->closed()) {
+            // 还没连上
+            return;
+        }
+        // 对手走了，或者发来了不合法的数据。下面照常走完这一帧，结果变成 Disconnected，显示出来
+        versus_match_->disconnect();
     }
-    current_block.anchor = {20, 3};
-    current_block_type = type;
-    current_block_rotation_state = RotationState::Zero;
-    can_exchange_hold = true;
-    on_land = false;
-    scheduled_frame_stamp_down.set_frame_stamp(*logical_frame_count);
-    scheduled_frame_stamp_down.set_state(ScheduledState::Loop);
-    this->refresh_shadow();
-}
 
-void GameData::exchange_hold() {
-    if (!can_exchange_hold) {
-        return;
+    if (bot_) {
+        // 机器人的操作不经过键盘，录像也就没有意义了
+        {
+            ZEETRIS_PROFILE_SCOPE("tick.bot");
+            drive_bot_();
+        }
+        game_data_->step(FrameInput{});
+    } else if (versus_match_) {
+        // 对战时收到的垃圾不在录像里，录像也放不出来
+        versus_match_->step_local(input);
+        versus_connection_->flush();
+        if (const auto result = versus_match_->result(); result != versus_result_) {
+            versus_result_ = result;
+            ZEETRIS_TICK_LOG_INFO("Versus result changed to {}", static_cast<int>(result));
+        }
+    } else {
+        replay_.record(input);
+        game_data_->step(input);
     }
 
-    const auto temp = current_block_type;
-    current_block_type = hold_block_type;
-    hold_block_type = temp;
-
-    // 如果 current_block_type 是 None 的话（意味着 hold 本来是 None），传给 new_block 生成一个新的；
-    // 如果不是，也传给它。
-    new_block(current_block_type);
-
-    can_exchange_hold = !can_exchange_hold;
-}
-
-bool GameData::check(block &block) {
-    return std::ranges::all_of(block.points, [this](auto point) {
-        return 0 <= point.x && point.x < 10 && 0 <= point.y && point.y < 22 &&
-               matrix[point.y][point.x] == BlockType::None;
-    });
-}
-
-void GameData::refresh_shadow() {
-    shadow_block = current_block;
-    // 一直让它下落，直到下落不了了为止
-    while (this->move(shadow_block, {-1, 0}, false))
-        ;
-}
-
-void GameData::lock() {
-    for (auto &[y, x]: current_block.points) {
-        matrix[y][x] = current_block_type;
+    if (spectator_server_) {
+        spectator_server_->broadcast(*game_data_);
     }
-    new_block();
-}
 
-void GameData::hard_drop() {
-    current_block = shadow_block;
-    lock();
+    ZEETRIS_PROFILE_SCOPE("tick.publish");
+    publish_snapshot_();
 }
 
-void GameData::logic_frame([[maybe_unused]] const boost::system::error_code &error_code,
-                           boost::asio::steady_timer *timer, std::atomic_size_t *logical_frame_count, std::mt19937 &rng,
-                           const std::shared_ptr<Keyboard> &keyboard, std::mutex *keyboard_mutex,
-                           std::atomic_flag *flag_thread_quit) {
-    timer->expires_after(boost::asio::chrono::nanoseconds(1000000000 / 60));
-    using sf::Keyboard::Scancode;
-
-    bool move_changed = false;
-    if (keyboard->is_key_pressed(Scancode::Left)) {
-        state_move_left = state_move_right + 1;
-        move_changed = true;
-    } else if (!keyboard->is_key_pressing(Scancode::Left) && state_move_left != 0) {
-        state_move_left = 0;
-        move_changed = true;
-    }
-    if (keyboard->is_key_pressed(Scancode::Right)) {
-        state_move_right = state_move_left + 1;
-        move_changed = true;
-    } else if (!keyboard->is_key_pressing(Scancode::Right) && state_move_right != 0) {
-        state_move_right = 0;
-        move_changed = true;
-    }
-
-    if (move_changed) {
-        if (state_move_left == state_move_right) {
-            scheduled_frame_stamp_move.set_state(ScheduledState::Inactive);
-            move_offset.x = 0;
-        } else {
-            spdlog::debug("Move started at frame {}", logical_frame_count->load());
-            scheduled_frame_stamp_move.set_state(ScheduledState::Loop);
-            scheduled_frame_stamp_move.set_frame_stamp(*logical_frame_count);
-            scheduled_frame_stamp_move.set_duration(GameConfig::DAS);
-            scheduled_frame_stamp_move.set_next_duration(std::make_optional(GameConfig::ARR));
-            move_offset.x = state_move_left > state_move_right ? -1 : 1;
-            // 按下的那一瞬间也是要移动的
-            move(current_block, move_offset);
-        }
-    }
-
-    if (keyboard->is_key_pressed(Scancode::Z)) {
-        rotate(current_block, current_block_rotation_state, current_block_type, RotationState::Left);
+void Game::publish_snapshot_() {
+    if (!snapshots_.unread()) {
+        // 渲染线程已经取走了上一份，之前的变化它都已经看到了
+        unread_dirty_rows_ = 0;
     }
-    if (keyboard->is_key_pressed(Scancode::X)) {
-        rotate(current_block, current_block_rotation_state, current_block_type, RotationState::Right);
+    // 否则上一份会被这一份覆盖，它的变化要一起带上。
+    // 即使渲染线程恰好在这之后取走了上一份，这一份也只是多标记了几行，不会漏掉
+    unread_dirty_rows_ |= game_data_->dirty_rows;
+    game_data_->dirty_rows = 0;
+
+    auto &snapshot = snapshots_.back();
+    snapshot.matrix_color = game_data_->matrix_color;
+    snapshot.dirty_rows = unread_dirty_rows_;
+    snapshot.current_block = game_data_->current_block;
+    snapshot.shadow_block = game_data_->shadow_block;
+    snapshot.current_block_type = game_data_->current_block_type;
+    snapshot.current_block_rotation_state = game_data_->current_block_rotation_state;
+    snapshot.hold_block_type = game_data_->hold_block_type;
+    snapshot.can_exchange_hold = game_data_->can_exchange_hold;
+    for (size_t idx = 0; idx < snapshot.next_block_types.size(); idx++) {
+        snapshot.next_block_types[idx] =
+                idx < game_data_->next_queue.size() ? game_data_->next_queue[idx] : BlockType::None;
     }
-    if (keyboard->is_key_pressed(Scancode::Space)) {
-        hard_drop();
+    snapshot.logical_frame_count = game_data_->logical_frame_count;
+    snapshot.score_state = game_data_->score_state;
+    snapshot.clear_line_count = game_data_->clear_line_count;
+    if (versus_match_) {
+        snapshot.versus_result = versus_match_->result();
     }
-    if (keyboard->is_key_pressed(Scancode::LShift)) {
-        exchange_hold();
-    }
-    if (keyboard->is_key_pressed(Scancode::Down)) {
-        scheduled_frame_stamp_down.set_duration(GameConfig::soft_down_delay);
-    } else if (!keyboard->is_key_pressing(Scancode::Down)) {
-        scheduled_frame_stamp_down.set_duration(GameConfig::down_delay);
-    }
-    {
-        std::lock_guard guard(*keyboard_mutex);
-        keyboard->update();
-    }
-
-    if (scheduled_frame_stamp_move.on_update(*logical_frame_count)) {
-        move(current_block, move_offset);
+    // 对手画的是预测到这一帧的局面，不用等网络延迟
+    if (const auto remote = versus_match_ ? versus_match_->predicted_remote() : nullptr) {
+        snapshot.has_opponent = true;
+        snapshot.opponent_matrix_color = remote->matrix_color;
+        snapshot.opponent_current_block = remote->current_block;
+        snapshot.opponent_current_block_type = remote->current_block_type;
     }
+    snapshots_.publish();
+}
 
-    // 着地 / 锁定逻辑
-    if (shadow_block == current_block && !scheduled_frame_stamp_lock.is_active()) {
-        scheduled_frame_stamp_lock.set_active(*logical_frame_count);
-        scheduled_frame_stamp_down.set_state(ScheduledState::Inactive);
-    } else if (shadow_block != current_block && scheduled_frame_stamp_lock.is_active()) {
-        scheduled_frame_stamp_lock.set_state(ScheduledState::Inactive);
-        scheduled_frame_stamp_down.set_frame_stamp(*logical_frame_count);
-        scheduled_frame_stamp_down.set_state(ScheduledState::Loop);
-    }
-    if (scheduled_frame_stamp_lock.on_update(*logical_frame_count)) {
-        lock();
+void Game::drive_bot_() {
+    const auto piece_id = game_data_->piece_count;
+    // 重力比 bot_delay 快的等级上不能等满，最多等下降一格的时间
+    const auto wait_frames = std::min(GameConfig::bot_delay, game_data_->down_delay() - 1);
+    if (bot_piece_id_ != piece_id) {
+        bot_piece_id_ = piece_id;
+        bot_piece_frame_ = game_data_->logical_frame_count;
+        bot_->think(*game_data_, std::chrono::steady_clock::now() +
+                                         std::chrono::nanoseconds(1000000000 / 60) * wait_frames);
+        return;
     }
-
-    // 下落逻辑
-    if (scheduled_frame_stamp_down.on_update(*logical_frame_count)) {
-        move(current_block, {-1, 0});
+    if (game_data_->logical_frame_count - bot_piece_frame_ < wait_frames) {
+        return;
     }
-
-    // 处理消行逻辑
-    {
-        size_t count = 0;
-        for (size_t y = 0; y < height_main + height_buffer; y++) {
-            if (std::ranges::all_of(matrix[y], [](auto block_type) { return block_type != BlockType::None; })) {
-                std::ranges::fill(matrix[y], BlockType::None);
-                count++;
-            } else if (count != 0) {
-                for (size_t x = 0; x < width; x++) {
-                    matrix[y - count][x] = matrix[y][x];
-                }
-                std::ranges::fill(matrix[y], BlockType::None);
-            }
+    // 结果还没出来就下一帧再看，绝不在这里等
+    if (const auto bot_move = bot_->best(piece_id)) {
+        // 思考的时候方块可能已经被重力拉下去了，机器人给的操作序列是从出生位置开始的
+        auto path = replan(*bot_move_generator_, *game_data_, bot_move->placement);
+        if (!path) {
+            ZEETRIS_TICK_LOG_WARN("Bot placement for piece {} is no longer reachable", piece_id);
+            path = bot_move->path;
         }
-        if (count > 0) {
-            clear_line_count += count;
-            spdlog::info("Cleared {} lines, {} in total", count, clear_line_count);
-            refresh_shadow();
+        if (!perform(*game_data_, *path)) {
+            ZEETRIS_TICK_LOG_WARN("Bot path for piece {} did not apply cleanly", piece_id);
         }
     }
-
-    // 预览块序列不足时，生成新的包
-    if (next_queue.size() == 7) {
-        new_bag(rng);
-    }
-
-    logical_frame_count->fetch_add(1);
-
-    if (flag_thread_quit->test()) {
-        return;
-    }
-
-    using namespace std::literals;
-
-    timer->async_wait(boost::bind(&GameData::logic_frame, this, boost::asio::placeholders::error, timer,
-                                  logical_frame_count, rng, keyboard, keyboard_mutex, flag_thread_quit));
 }
 
-Game::Game(sf::RenderWindow *render_window, std::shared_ptr<sf::Font> font) {
-    game_data_ = std::make_shared<GameData>(&logical_frame_count_);
-    keyboard_ = std::make_shared<Keyboard>();
-    font_ = std::move(font);
-    render_window_ = render_window;
-}
-
-void Game::handle_game_logic(std::mt19937 &rng, std::atomic_flag *flag_thread_quit) {
+void Game::handle_game_logic(std::atomic_flag *flag_thread_quit) {
     using namespace std::literals;
 
-    logical_thread_ = std::move(std::thread{[this, rng, flag_thread_quit]() {
+    logical_thread_ = std::move(std::thread{[this, flag_thread_quit]() {
         boost::asio::io_context io_context;
-        boost::asio::steady_timer asio_steady_timer{io_context, boost::asio::chrono::nanoseconds(1000000000 / 60)};
-        asio_steady_timer.async_wait(boost::bind(&GameData::logic_frame, game_data_, boost::asio::placeholders::error,
-                                                 &asio_steady_timer, &logical_frame_count_, rng, keyboard_,
-                                                 &keyboard_mutex_, flag_thread_quit));
+        if (versus_endpoint_) {
+            // 连接和收发也挂在这个 io_context 上。连上对手之前 tick_() 什么都不做
+            versus_match_ = std::make_unique<VersusMatch>(*game_data_, replay_.seed);
+            versus_connection_ = std::make_unique<VersusConnection>(io_context, *versus_endpoint_, *versus_match_,
+                                                                    [this] { publish_snapshot_(); });
+            try {
+                versus_connection_->start();
+            } catch (const std::exception &exception) {
+                spdlog::error("Failed to start the versus connection: {}", exception.what());
+                versus_connection_->close();
+            }
+        }
+        if (spectator_port_) {
+            try {
+                spectator_server_ = std::make_unique<SpectatorServer>(io_context, *spectator_port_);
+                spectator_server_->start();
+            } catch (const std::exception &exception) {
+                spdlog::error("Failed to start the spectator server: {}", exception.what());
+                spectator_server_.reset();
+            }
+        }
+        tick_scheduler_.start(TickScheduler::clock::now());
+        boost::asio::steady_timer asio_steady_timer{io_context, tick_scheduler_.next_deadline()};
+        asio_steady_timer.async_wait(boost::bind(&Game::logic_frame, this, boost::asio::placeholders::error,
+                                                 &asio_steady_timer, flag_thread_quit));
+        Profiler::instance().set_thread_name("logic");
         spdlog::info("Game logic thread has been started");
         io_context.run();
+        // socket 不能比它的 io_context 活得久
+        versus_connection_.reset();
+        spectator_server_.reset();
         spdlog::info("Game logic thread has been quit");
+
+        const auto &metrics = tick_scheduler_.metrics();
+        const auto microseconds = [](const TickMetrics::duration duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+        spdlog::info("Ran {} ticks in {} wakeups, {} missed; lateness mean {} us, max {} us; "
+                     "handler mean {} us, max {} us",
+                     metrics.tick_count, metrics.wakeup_count, metrics.missed_tick_count,
+                     microseconds(metrics.mean_lateness()), microseconds(metrics.max_lateness),
+                     microseconds(metrics.mean_handler_duration()), microseconds(metrics.max_handler_duration));
+
+        if (!bot_ && !versus_endpoint_) {
+            try {
+                std::filesystem::create_directories("replays");
+                const auto path = std::format("replays/zeetris-{}.zrp", replay_.seed);
+                replay_.save(path);
+                spdlog::info("Replay of {} frames saved to {}", replay_.frame_count(), path);
+            } catch (const std::exception &exception) {
+                spdlog::error("Failed to save replay: {}", exception.what());
+            }
+        }
+
         flag_thread_quit->test_and_set();
         flag_thread_quit->notify_all();
     }});
-
-    logical_thread_.detach();
 }
 
 void Game::run() {
     using namespace std::literals; // 启用后缀，例如 24h, 1ms, 1s 之类的
 
-    const auto update_vertices = [this](sf::Vertex *begin, const size_t offset, const size_t position_y,
-                                        const size_t position_x, const sf::Color color) {
-        auto [screen_width, screen_height] = this->render_window_->getSize();
-        const auto offset_width = static_cast<float>(screen_width) / 2.f -
-                                  static_cast<float>(GameData::width) / 2.f * GameConfig::block_size;
-        const auto offset_height = static_cast<float>(screen_height) / 2.f -
-                                   static_cast<float>(GameData::height_main) / 2.f * GameConfig::block_size;
-
-        const auto y = static_cast<int32_t>(position_y);
-        const auto x = static_cast<int32_t>(position_x);
-
-        // 注意这里 sf::Vector2f 先是 x 再是 y 的，和项目里通行的记法正好相反
-        begin[offset + 0].position = sf::Vector2f{
-                static_cast<float>(x + 0) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 1) * GameConfig::block_size + offset_height};
-        begin[offset + 1].position = sf::Vector2f{
-                static_cast<float>(x + 0) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 0) * GameConfig::block_size + offset_height};
-        begin[offset + 2].position = sf::Vector2f{
-                static_cast<float>(x + 1) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 1) * GameConfig::block_size + offset_height};
-
-        begin[offset + 3].position = sf::Vector2f{
-                static_cast<float>(x + 1) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 1) * GameConfig::block_size + offset_height};
-        begin[offset + 4].position = sf::Vector2f{
-                static_cast<float>(x + 0) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 0) * GameConfig::block_size + offset_height};
-        begin[offset + 5].position = sf::Vector2f{
-                static_cast<float>(x + 1) * GameConfig::block_size + offset_width,
-                static_cast<float>(GameData::height_main - y - 0) * GameConfig::block_size + offset_height};
-
-        for (size_t idx = offset; idx < offset + 6; idx++) {
-            begin[idx].color = color;
-        }
+    constexpr size_t matrix_height = GameData::height_main + GameData::height_buffer;
+    constexpr size_t vertices_per_row = GameData::width * 6;
+    constexpr size_t matrix_vertex_count = matrix_height * vertices_per_row;
+    constexpr size_t block_vertex_count = 4 * 6;
+    // 所有东西都在一个批里，按画的先后排好，每一部分占固定的一段
+    constexpr size_t opponent_matrix_offset = 0;
+    constexpr size_t opponent_block_offset = opponent_matrix_offset + matrix_vertex_count;
+    constexpr size_t matrix_offset = opponent_block_offset + block_vertex_count;
+    constexpr size_t current_block_offset = matrix_offset + matrix_vertex_count;
+    // 旋转中心的方框是四条 1 像素宽的细长矩形
+    constexpr size_t rotating_center_offset = current_block_offset + block_vertex_count;
+    constexpr size_t shadow_block_offset = rotating_center_offset + 4 * 6;
+    constexpr size_t hold_block_offset = shadow_block_offset + block_vertex_count;
+    constexpr size_t next_blocks_offset = hold_block_offset + block_vertex_count;
+    constexpr size_t text_offset = next_blocks_offset + GameConfig::preview_count * block_vertex_count;
+    constexpr size_t text_count = 6;
+    constexpr size_t batch_size = text_offset + text_count * TextSlot::vertex_count;
+
+    const GlyphAtlas atlas{*font_, 24};
+    RenderBatch batch{batch_size};
+    // 除了文字都是纯色的，纹理坐标一直指着白色的格子
+    batch.fill_texture_coords(0, text_offset, atlas.white_texel());
+
+    std::array<TextSlot, text_count> texts{
+            TextSlot{text_offset + 0 * TextSlot::vertex_count, {0, 0 * atlas.line_spacing()}},
+            TextSlot{text_offset + 1 * TextSlot::vertex_count, {0, 1 * atlas.line_spacing()}},
+            TextSlot{text_offset + 2 * TextSlot::vertex_count, {0, 2 * atlas.line_spacing()}},
+            TextSlot{text_offset + 3 * TextSlot::vertex_count, {0, 3 * atlas.line_spacing()}},
+            TextSlot{text_offset + 4 * TextSlot::vertex_count, {0, 4 * atlas.line_spacing()}},
+            TextSlot{text_offset + 5 * TextSlot::vertex_count, {0, 5 * atlas.line_spacing()}},
     };
-
-    std::array<sf::Vertex, (GameData::height_main + GameData::height_buffer) * GameData::width * 6> vertices_matrix;
-    std::array<sf::Vertex, 4 * 6> vertices_current_block;
-    std::array<sf::Vertex, 4 * 6> vertices_shadow_block;
-    std::array<sf::Vertex, 5> vertices_rotating_center;
-
-    sf::Text text_fps{*font_, L"Unknown fps", 24};
-    sf::Text text_frame_count{*font_, L"frame_count_: 0", 24};
-    sf::Text text_logical_frame_count{*font_, L"logical_frame_count_: 0", 24};
-    sf::Text text_rotation{*font_, L"rotation: 0", 24};
-    text_frame_count.setPosition({0, text_fps.getGlobalBounds().position.y + text_fps.getGlobalBounds().size.y});
-    text_logical_frame_count.setPosition(
-            {0, text_frame_count.getGlobalBounds().position.y + text_frame_count.getGlobalBounds().size.y});
-    text_rotation.setPosition({0, text_logical_frame_count.getGlobalBounds().position.y +
-                                          text_logical_frame_count.getGlobalBounds().size.y});
+    auto &[text_fps, text_frame_count, text_logical_frame_count, text_rotation, text_score, text_versus] = texts;
+    text_fps.set(batch, atlas, "Unknown fps");
+    if (versus_endpoint_) {
+        text_versus.set(batch, atlas, "Waiting for opponent");
+    }
+    // 帧率每半秒算一次平均，不用每帧都重新排字
+    size_t fps_frame_count = 0;
+    auto fps_start = std::chrono::steady_clock::now();
+
+    // 对战时两块场地并排，各自从正中往两边让出 7 格，中间留出放预览块的地方
+    const float versus_shift = versus_endpoint_ ? 7.f * GameConfig::block_size : 0.f;
+    // 上一次画对手时的状态，没变就不重新算
+    VersusResult drawn_versus_result{VersusResult::Playing};
+    bool drawn_has_opponent = false;
+    bool redraw_opponent = false;
+    // 上一次画的暂存块和预览块，没变就不重新算
+    BlockType drawn_hold_block_type{BlockType::None};
+    bool drawn_can_exchange_hold{};
+    std::array<BlockType, GameConfig::preview_count> drawn_next_block_types{};
+    bool redraw_previews = true;
+    // 当前方块、旋转中心和影子只在拿到新的快照时重新算
+    bool redraw_blocks = true;
 
     std::atomic_flag flag_thread_quit{};
+    // 不管 run() 从哪里退出（窗口关了、渲染时抛了异常），都让逻辑线程退出，等它把最后一帧跑完、把录像存下来。
+    // 在 flag_thread_quit 之后构造，所以先于它析构，逻辑线程不会用到一个已经销毁的标志
+    class logic_thread_guard {
+    public:
+        Game *game;
+        std::atomic_flag *flag_thread_quit;
+
+        ~logic_thread_guard() {
+            flag_thread_quit->test_and_set();
+            if (game->logical_thread_.joinable()) {
+                game->logical_thread_.join();
+            }
+        }
+    } const guard{this, &flag_thread_quit};
 
-    // 初始化游戏数据
-    auto rd = std::random_device();
-    auto rng = std::mt19937(rd());
-    game_data_->new_bag(rng, 2);
-    game_data_->new_block();
+    // 初始化游戏数据。逻辑线程还没开始，这里发布的第一份快照不会和它竞争
+    game_data_->start();
+    game_data_->dirty_rows = UINT32_MAX;
+    publish_snapshot_();
+    // 渲染线程自己也可能要求重画所有行，比如窗口大小变了的时候
+    uint32_t redraw_rows = 0;
 
-    handle_game_logic(rng, &flag_thread_quit);
+    Profiler::instance().set_thread_name("render");
+    handle_game_logic(&flag_thread_quit);
 
     while (render_window_->isOpen()) {
-        const std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
-
         // vvv 处理游戏逻辑
-        while (const std::optional event = render_window_->pollEvent()) {
-            if (event->is<sf::Event::Closed>()) {
-                render_window_->close();
-                flag_thread_quit.test_and_set();
-                return;
-            }
+        {
+            ZEETRIS_PROFILE_SCOPE("render.poll_events");
+            while (const std::optional event = render_window_->pollEvent()) {
+                if (event->is<sf::Event::Closed>()) {
+                    render_window_->close();
+                    return;
+                }
+
+                if (event->is<sf::Event::Resized>()) {
+                    // 场地的位置跟着窗口大小走，所有东西都要重新算
+                    redraw_rows = UINT32_MAX;
+                    redraw_opponent = true;
+                    redraw_previews = true;
+                    redraw_blocks = true;
+                }
 
-            std::lock_guard guard(keyboard_mutex_);
-            keyboard_->update_event(*event);
+                keyboard_->update_event(*event);
+            }
         }
         // keyboard_->update();
         // ^^^ 处理游戏逻辑
 
         // vvv 计算 vertices
-        for (size_t y = 0; y < GameData::height_main + GameData::height_buffer; y++) {
-            for (size_t x = 0; x < GameData::width; x++) {
-                const size_t offset = (y * GameData::width + x) * 6;
-                update_vertices(vertices_matrix.data(), offset, y, x, block_colors[game_data_->matrix[y][x]]);
-            }
+        // 取最新的快照，没有新的就继续用上一份
+        if (snapshots_.update()) {
+            redraw_rows |= snapshots_.front().dirty_rows;
+            redraw_opponent = redraw_opponent || snapshots_.front().has_opponent;
+            redraw_blocks = true;
         }
+        const auto &snapshot = snapshots_.front();
 
-        for (size_t idx = 0; idx < game_data_->current_block.points.size(); idx++) {
-            auto &[y, x] = game_data_->current_block.points[idx];
-            update_vertices(vertices_current_block.data(), idx * 6, y, x, block_colors[game_data_->current_block_type]);
-        }
+        {
+            ZEETRIS_PROFILE_SCOPE("render.build_vertices");
+            auto origin = field_origin(render_window_->getSize());
+            if (redraw_opponent && snapshot.has_opponent) {
+                redraw_opponent = false;
+                const sf::Vector2f opponent_origin{origin.x + versus_shift, origin.y};
+                auto *vertices = batch.region(opponent_matrix_offset, matrix_vertex_count + block_vertex_count).data();
+                for (size_t y = 0; y < matrix_height; y++) {
+                    for (size_t x = 0; x < GameData::width; x++) {
+                        update_cell_vertices(vertices, y * vertices_per_row + x * 6, opponent_origin, y, x,
+                                             block_colors[static_cast<size_t>(snapshot.opponent_matrix_color[y][x])]);
+                    }
+                }
+                for (size_t idx = 0; idx < snapshot.opponent_current_block.points.size(); idx++) {
+                    auto &[y, x] = snapshot.opponent_current_block.points[idx];
+                    update_cell_vertices(vertices, matrix_vertex_count + idx * 6, opponent_origin, y, x,
+                                         block_colors[static_cast<size_t>(snapshot.opponent_current_block_type)]);
+                }
+            }
+            if (versus_endpoint_ &&
+                (snapshot.has_opponent != drawn_has_opponent || snapshot.versus_result != drawn_versus_result)) {
+                drawn_has_opponent = snapshot.has_opponent;
+                drawn_versus_result = snapshot.versus_result;
+                constexpr std::array<std::string_view, 5> result_names{"Playing", "You win", "You lose", "Draw",
+                                                                       "Opponent disconnected"};
+                // 还没连上就断开了的话，也要显示出来
+                text_versus.set(batch, atlas,
+                                snapshot.has_opponent || snapshot.versus_result != VersusResult::Playing
+                                        ? result_names[static_cast<size_t>(snapshot.versus_result)]
+                                        : "Waiting for opponent");
+            }
+            origin.x -= versus_shift;
+            // 大多数帧里场地都没有变化，只重新计算、上传逻辑线程标记过的行
+            for (auto rows = redraw_rows & ((1u << matrix_height) - 1); rows != 0; rows &= rows - 1) {
+                const auto y = static_cast<size_t>(std::countr_zero(rows));
+                auto *vertices = batch.region(matrix_offset + y * vertices_per_row, vertices_per_row).data();
+                for (size_t x = 0; x < GameData::width; x++) {
+                    update_cell_vertices(vertices, x * 6, origin, y, x,
+                                         block_colors[static_cast<size_t>(snapshot.matrix_color[y][x])]);
+                }
+            }
+            redraw_rows = 0;
+
+            if (redraw_blocks) {
+                redraw_blocks = false;
+                auto *vertices =
+                        batch.region(current_block_offset, hold_block_offset - current_block_offset).data();
+                for (size_t idx = 0; idx < snapshot.current_block.points.size(); idx++) {
+                    auto &[y, x] = snapshot.current_block.points[idx];
+                    update_cell_vertices(vertices, idx * 6, origin, y, x,
+                                         block_colors[static_cast<size_t>(snapshot.current_block_type)]);
+                }
 
-        for (size_t idx = 0; idx < game_data_->shadow_block.points.size(); idx++) {
-            auto &[y, x] = game_data_->shadow_block.points[idx];
-            update_vertices(vertices_shadow_block.data(), idx * 6, y, x, sf::Color{255, 255, 255, 196});
-        }
+                {
+                    // -这是什么？ -是用来显示旋转中心的。 -原来是这样啊？
+                    auto [center_y, center_x] =
+                            rotating_centers[static_cast<size_t>(snapshot.current_block_type)];
+                    center_y += static_cast<float>(snapshot.current_block.anchor.y - 0.5);
+                    center_x += static_cast<float>(snapshot.current_block.anchor.x + 0.5);
+                    center_y = (static_cast<float>(GameData::height_main) - center_y - 1.f) * GameConfig::block_size +
+                               origin.y;
+                    center_x = center_x * GameConfig::block_size + origin.x;
+                    const auto center = rotating_center_offset - current_block_offset;
+                    update_quad_vertices(vertices, center + 0, {center_x - 5.f, center_y - 5.f}, {11.f, 1.f},
+                                         sf::Color::White);
+                    update_quad_vertices(vertices, center + 6, {center_x - 5.f, center_y + 5.f}, {11.f, 1.f},
+                                         sf::Color::White);
+                    update_quad_vertices(vertices, center + 12, {center_x - 5.f, center_y - 5.f}, {1.f, 11.f},
+                                         sf::Color::White);
+                    update_quad_vertices(vertices, center + 18, {center_x + 5.f, center_y - 5.f}, {1.f, 11.f},
+                                         sf::Color::White);
+                }
 
-        {
-            // -这是什么？ -是用来显示旋转中心的。 -原来是这样啊？
-            auto [screen_width, screen_height] = this->render_window_->getSize();
-            const auto offset_width = static_cast<float>(screen_width) / 2.f -
-                                      static_cast<float>(GameData::width) / 2.f * GameConfig::block_size;
-            const auto offset_height = static_cast<float>(screen_height) / 2.f -
-                                       static_cast<float>(GameData::height_main) / 2.f * GameConfig::block_size;
-            auto [center_y, center_x] = rotating_centers[game_data_->current_block_type];
-            center_y += static_cast<float>(game_data_->current_block.anchor.y - 0.5);
-            center_x += static_cast<float>(game_data_->current_block.anchor.x + 0.5);
-            center_y = (static_cast<float>(GameData::height_main) - center_y - 1.f) * GameConfig::block_size;
-            center_x = center_x * GameConfig::block_size;
-            vertices_rotating_center[0].position = {center_x - 5.f + offset_width, center_y - 5.f + offset_height};
-            vertices_rotating_center[1].position = {center_x - 5.f + offset_width, center_y + 5.f + offset_height};
-            vertices_rotating_center[2].position = {center_x + 5.f + offset_width, center_y + 5.f + offset_height};
-            vertices_rotating_center[3].position = {center_x + 5.f + offset_width, center_y - 5.f + offset_height};
-            vertices_rotating_center[4].position = {center_x - 5.f + offset_width, center_y - 5.f + offset_height};
+                for (size_t idx = 0; idx < snapshot.shadow_block.points.size(); idx++) {
+                    auto &[y, x] = snapshot.shadow_block.points[idx];
+                    update_cell_vertices(vertices, shadow_block_offset - current_block_offset + idx * 6, origin, y,
+                                         x, sf::Color{255, 255, 255, 196});
+                }
+            }
+
+            if (redraw_previews || snapshot.hold_block_type != drawn_hold_block_type ||
+                snapshot.can_exchange_hold != drawn_can_exchange_hold ||
+                snapshot.next_block_types != drawn_next_block_types) {
+                redraw_previews = false;
+                drawn_hold_block_type = snapshot.hold_block_type;
+                drawn_can_exchange_hold = snapshot.can_exchange_hold;
+                drawn_next_block_types = snapshot.next_block_types;
+                // 暂存块在场地左边，预览块在右边往下排，都用半格大小
+                constexpr float preview_cell_size = GameConfig::block_size / 2.f;
+                auto *vertices = batch.region(hold_block_offset, text_offset - hold_block_offset).data();
+                update_preview_vertices(vertices, 0, {origin.x - 5.f * preview_cell_size, origin.y},
+                                        preview_cell_size, snapshot.hold_block_type,
+                                        snapshot.can_exchange_hold ? std::nullopt
+                                                                   : std::optional{block_colors.back()});
+                for (size_t idx = 0; idx < snapshot.next_block_types.size(); idx++) {
+                    update_preview_vertices(vertices, (idx + 1) * block_vertex_count,
+                                            {origin.x + static_cast<float>(GameData::width) * GameConfig::block_size +
+                                                     preview_cell_size,
+                                             origin.y + static_cast<float>(idx) * 3.f * preview_cell_size},
+                                            preview_cell_size, snapshot.next_block_types[idx]);
+                }
+            }
+
+            // 文字只有内容变了才重新排
+            const auto now = std::chrono::steady_clock::now();
+            fps_frame_count++;
+            if (now - fps_start >= 500ms) {
+                const std::chrono::duration<double> elapsed = now - fps_start;
+                text_fps.set(batch, atlas,
+                             std::format("{:.0f} fps", static_cast<double>(fps_frame_count) / elapsed.count()));
+                fps_frame_count = 0;
+                fps_start = now;
+            }
+            text_frame_count.set(batch, atlas, std::format("frame_count_: {}", frame_count_));
+            text_logical_frame_count.set(batch, atlas,
+                                         std::format("logical_frame_count_: {}", snapshot.logical_frame_count));
+            text_rotation.set(batch, atlas,
+                              std::format("rotation: {}", static_cast<int>(snapshot.current_block_rotation_state)));
+            text_score.set(batch, atlas,
+                           std::format("score: {}, level: {}, lines: {}, combo: {}{}", snapshot.score_state.score,
+                                       ScoreState::level_of(snapshot.clear_line_count), snapshot.clear_line_count,
+                                       std::max(snapshot.score_state.combo, 0),
+                                       snapshot.score_state.back_to_back ? ", B2B" : ""));
         }
         // ^^^ 计算 vertices
 
-        render_window_->clear();
-        render_window_->draw(text_fps);
-        render_window_->draw(text_frame_count);
-        render_window_->draw(text_logical_frame_count);
-        render_window_->draw(text_rotation);
-        render_window_->draw(vertices_matrix.data(), vertices_matrix.size(), sf::PrimitiveType::Triangles);
-        render_window_->draw(vertices_current_block.data(), vertices_current_block.size(),
-                             sf::PrimitiveType::Triangles);
-        render_window_->draw(vertices_rotating_center.data(), vertices_rotating_center.size(),
-                             sf::PrimitiveType::LineStrip);
-        render_window_->draw(vertices_shadow_block.data(), vertices_shadow_block.size(), sf::PrimitiveType::Triangles);
-        render_window_->display();
+        {
+            ZEETRIS_PROFILE_SCOPE("render.draw");
+            render_window_->clear();
+            batch.draw(*render_window_, atlas.texture());
+        }
+        {
+            ZEETRIS_PROFILE_SCOPE("render.display");
+            render_window_->display();
+        }
 
         // 帧结束，自增
         frame_count_++;
-
-        const std::chrono::time_point<std::chrono::steady_clock> end = std::chrono::steady_clock::now();
-        text_fps.setString(std::format(L"{} fps", 1s / (end - start)));
-        text_frame_count.setString(std::format(L"frame_count_: {}", frame_count_));
-        text_logical_frame_count.setString(
-                std::format(L"logical_frame_count_: {}", static_cast<size_t>(logical_frame_count_)));
-        text_rotation.setString(
-                std::format(L"rotation: {}", static_cast<int>(game_data_->current_block_rotation_state)));
     }
 }
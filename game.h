@@ -5,330 +5,75 @@
 #include <array>
 #include <atomic>
 #include <boost/asio.hpp>
-#include <list>
-#include <map>
 #include <memory>
-#include <random>
+#include <optional>
 #include <thread>
-#include <utility>
 
+#include "bot.h"
+#include "field_vertices.h"
+#include "game_data.h"
 #include "keyboard.h"
-#include "scheduled_frame_stamp.h"
-
-
-/// 表示一个点 / 一个坐标。由于这个项目的特殊性，先存储 y 再存储 x，要与 SFML 中通行的 (x, y) 存储方式区别开来。
-template<typename T>
-class point {
-public:
-    T y, x;
-
-    bool operator==(const point<T> &point) const = default;
-};
-
-/// 一个方块。
-class block {
-public:
-    /// 表示每个点的坐标
-    std::array<point<int32_t>, 4> points;
-
-    /// 锚点所在。用于超级旋转系统。
-    point<int32_t> anchor{0, 0};
-
-    bool operator==(const block &block) const;
-};
-
-/// 预设值，表示每个方块对应的 4 个点的坐标。
-static constexpr std::array blocks{
-        block{
-                point{0, 0},
-                {0, 0},
-                {0, 0},
-                {0, 0},
-        },
-
-        block{
-                point{0, 0},
-                {0, 1},
-                {0, 2},
-                {0, 3},
-        }, // I
-        block{
-                point{0, 0},
-                {1, 0},
-                {0, 1},
-                {0, 2},
-        }, // J
-        block{
-                point{0, 0},
-                {0, 1},
-                {0, 2},
-                {1, 2},
-        }, // L
-        block{
-                point{0, 1},
-                {0, 2},
-                {1, 1},
-                {1, 2},
-        }, // O
-        block{
-                point{0, 0},
-                {0, 1},
-                {1, 1},
-                {1, 2},
-        }, // S
-        block{
-                point{1, 0},
-                {1, 1},
-                {0, 1},
-                {0, 2},
-        }, // Z
-        block{
-                point{0, 0},
-                {0, 1},
-                {0, 2},
-                {1, 1},
-        }, // T
-};
-
-/// 方块类型。默认应该是 None (0)。
-enum class BlockType {
-    Unknown = -1,
-    None = 0,
-    I,
-    J,
-    L,
-    O,
-    S,
-    Z,
-    T,
-};
-
-/// 预设值，表示一种方块对应的颜色值
-static std::map<BlockType, sf::Color> block_colors{
-        {BlockType::None, sf::Color::Transparent},
-        {BlockType::I, sf::Color::Cyan},
-        {BlockType::J, sf::Color::Blue},
-        {BlockType::L, sf::Color{225, 127, 0}},
-        {BlockType::O, sf::Color::Yellow},
-        {BlockType::S, sf::Color::Green},
-        {BlockType::Z, sf::Color::Red},
-        {BlockType::T, sf::Color{128, 0, 128}},
-};
-
-/// 预设值，表示一种方块对应的旋转中心（相对于锚点）
-static std::map<BlockType, point<float>> rotating_centers{
-        {BlockType::None, {0.f, 0.f}}, {BlockType::I, {-0.5f, 1.5f}}, {BlockType::J, {0.f, 1.f}},
-        {BlockType::L, {0.f, 1.f}},    {BlockType::O, {0.5f, 1.5f}},  {BlockType::S, {0.f, 1.f}},
-        {BlockType::Z, {0.f, 1.f}},    {BlockType::T, {0.f, 1.f}},
-};
-
-/// 旋转的状态 / 方向。
-///
-/// 当表示旋转的方向的时候，Zero 是没有意义的。
-enum class RotationState {
-    /// 初始状态
-    Zero = 0,
-    /// 初始态顺时针旋转（右转）后的状态 / 顺时针旋转
-    Right = 1,
-    /// 初始态旋转 180° 后的状态 / 180° 旋转
-    Two = 2,
-    /// 初始态逆时针旋转（左转）后的状态 / 逆时针旋转
-    Left = 3,
-};
-
-using kickwall = std::map<std::pair<RotationState, RotationState>, std::vector<point<int32_t>>>;
-
-/// JLSTZ 的踢墙表
-static kickwall kickwall_JLSTZ{{std::pair{RotationState::Zero, RotationState::Right},
-                                std::vector{point{0, 0}, {-1, 0}, {-1, +1}, {0, -2}, {-1, -2}}},
-                               {std::pair{RotationState::Right, RotationState::Zero},
-                                std::vector{point{0, 0}, {+1, 0}, {+1, -1}, {0, +2}, {+1, +2}}},
-                               {std::pair{RotationState::Right, RotationState::Two},
-                                std::vector{point{0, 0}, {+1, 0}, {+1, -1}, {0, +2}, {+1, +2}}},
-                               {std::pair{RotationState::Two, RotationState::Right},
-                                std::vector{point{0, 0}, {-1, 0}, {-1, +1}, {0, -2}, {-1, -2}}},
-                               {std::pair{RotationState::Two, RotationState::Left},
-                                std::vector{point{0, 0}, {+1, 0}, {+1, +1}, {0, -2}, {+1, -2}}},
-                               {std::pair{RotationState::Left, RotationState::Two},
-                                std::vector{point{0, 0}, {-1, 0}, {-1, -1}, {0, +2}, {-1, +2}}},
-                               {std::pair{RotationState::Left, RotationState::Zero},
-                                std::vector{point{0, 0}, {-1, 0}, {-1, -1}, {0, +2}, {-1, +2}}},
-                               {std::pair{RotationState::Zero, RotationState::Left},
-                                std::vector{point{0, 0}, {+1, 0}, {+1, +1}, {0, -2}, {+1, -2}}}};
-
-/// I 的踢墙表
-static kickwall kickwall_I{{std::pair{RotationState::Zero, RotationState::Right},
-                            std::vector{point{0, 0}, {-2, 0}, {+1, 0}, {-2, -1}, {+1, +2}}},
-                           {std::pair{RotationState::Right, RotationState::Zero},
-                            std::vector{point{0, 0}, {+2, 0}, {-1, 0}, {+2, +1}, {-1, -2}}},
-                           {std::pair{RotationState::Right, RotationState::Two},
-                            std::vector{point{0, 0}, {-1, 0}, {+2, 0}, {-1, +2}, {+2, -1}}},
-                           {std::pair{RotationState::Two, RotationState::Right},
-                            std::vector{point{0, 0}, {+1, 0}, {-2, 0}, {+1, -2}, {-2, +1}}},
-                           {std::pair{RotationState::Two, RotationState::Left},
-                            std::vector{point{0, 0}, {+2, 0}, {-1, 0}, {+2, +1}, {-1, -2}}},
-                           {std::pair{RotationState::Left, RotationState::Two},
-                            std::vector{point{0, 0}, {-2, 0}, {+1, 0}, {-2, -1}, {+1, +2}}},
-                           {std::pair{RotationState::Left, RotationState::Zero},
-                            std::vector{point{0, 0}, {+1, 0}, {-2, 0}, {+1, -2}, {-2, +1}}},
-                           {std::pair{RotationState::Zero, RotationState::Left},
-                            std::vector{point{0, 0}, {-1, 0}, {+2, 0}, {-1, +2}, {+2, -1}}}};
-
-/// O 的踢墙表（实际上没有）
-static kickwall kickwall_O{{std::pair{RotationState::Zero, RotationState::Right}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Right, RotationState::Zero}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Right, RotationState::Two}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Two, RotationState::Right}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Two, RotationState::Left}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Left, RotationState::Two}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Left, RotationState::Zero}, std::vector<point<int32_t>>{}},
-                           {std::pair{RotationState::Zero, RotationState::Left}, std::vector<point<int32_t>>{}}};
-
-/// 获取对应方块类型的踢墙表。
-/// @param block_type 获取的方块类型
-/// @return 对应方块类型的踢墙表
-kickwall *get_kickwall(BlockType block_type);
-
-/// 游戏设置
-class GameConfig {
-public:
-    /// 渲染相关：方块大小
-    static constexpr float block_size = 25.f;
-
-    /// 逻辑相关：下降延迟 (frame / 60 frames)
-    static constexpr size_t down_delay = 60;
-    /// 逻辑相关：软降延迟 (frame / 60 frames)
-    static constexpr size_t soft_down_delay = 3;
-    /// 逻辑相关：锁定延迟 (frame / 60 frames)
-    static constexpr size_t lock_delay = 90;
-
-    /// 操作相关：自动移动延迟 (DAS) (frame / 60 frames)
-    static constexpr size_t DAS = 10;
-    /// 操作相关：移动重复延迟 (ARR) (frame / 60 frames)
-    static constexpr size_t ARR = 2;
+#include "replay.h"
+#include "spectator_server.h"
+#include "tick_scheduler.h"
+#include "triple_buffer.h"
+#include "versus_connection.h"
+#include "versus_match.h"
+
+
+/// 按键绑定，以 key_bindings[InputKey] 的方式访问。
+static constexpr std::array key_bindings{
+        sf::Keyboard::Scancode::Left, sf::Keyboard::Scancode::Right, sf::Keyboard::Scancode::Z,
+        sf::Keyboard::Scancode::X,    sf::Keyboard::Scancode::Space, sf::Keyboard::Scancode::LShift,
+        sf::Keyboard::Scancode::Down,
 };
 
-/// 用来存储游戏数据的类。一些与游戏数据操作有关的方法也放在这里面，但是不是 static 的。
-class GameData {
+/// 渲染需要的游戏状态。逻辑线程每一帧写一份，通过 TripleBuffer 交给渲染线程，渲染线程不会直接读 GameData。
+class RenderSnapshot {
 public:
-    /// 当前的方块。注意现在所有的方块都是 4 连方块。
+    /// 场地的颜色平面
+    decltype(GameData::matrix_color) matrix_color{};
+    /// 从渲染线程上一次取到的快照以来，matrix_color 中有变化的行
+    uint32_t dirty_rows{};
+    /// 当前方块
     block current_block{};
-    /// 影子方块。这个应该是惰性的，就是只有在场地 / 方块更新时才重新计算这个
+    /// 影子方块
     block shadow_block{};
-    /// 备用的方块，这个做什么都可以。
-    block temp_block{};
-
-    /// 当前方块的旋转状态
-    RotationState current_block_rotation_state{RotationState::Zero};
     /// 当前方块的类型
-    BlockType current_block_type = BlockType::None;
-    /// 暂存块的类型
-    BlockType hold_block_type = BlockType::None;
-
-    /// 预览序列。这是一个链表 list。
-    std::list<BlockType> next_queue{};
-
-    /// 主场地的高 (y)
-    static constexpr int32_t height_main = 20;
-    /// 缓冲区的高 (y + height_main)
-    static constexpr int32_t height_buffer = 2;
-    /// 场地的宽 (x)
-    static constexpr size_t width = 10;
-
-    /// 场地 / 矩阵，y = 0 为底，以 matrix[y][x] 的方式访问。
-    std::array<std::array<BlockType, width>, height_main + height_buffer> matrix{};
-
-    std::atomic_size_t *logical_frame_count = nullptr;
-
+    BlockType current_block_type{BlockType::None};
+    /// 当前方块的旋转状态
+    RotationState current_block_rotation_state{};
+    /// 暂存块
+    BlockType hold_block_type{BlockType::None};
     /// 是否可以交换暂存块
-    bool can_exchange_hold = true;
-    /// 当前方块是否在地上
-    bool on_land = false;
-    /// 如果锁在地上，开始的帧数戳
-    [[deprecated]] size_t frame_stamp_lock{};
-
-    /// 锁定计划帧
-    ScheduledFrameStamp scheduled_frame_stamp_lock{0, GameConfig::lock_delay};
-    /// 下降计划帧
-    ScheduledFrameStamp scheduled_frame_stamp_down{0, GameConfig::down_delay, ScheduledState::Loop};
-
-    /// 移动计划帧
-    ScheduledFrameStamp scheduled_frame_stamp_move{0, GameConfig::DAS};
-    /// 左移的状态。
-    /// 请见代码中对这个变量的具体解释。
-    int32_t state_move_left{0};
-    /// 右移的状态。
-    /// 请见代码中对这个变量的具体解释。
-    int32_t state_move_right{0};
-    /// 移动的偏移
-    /// 请见代码中对这个变量的具体解释。
-    point<int32_t> move_offset{0, 0};
-
+    bool can_exchange_hold{};
+    /// 预览序列的前几个
+    std::array<BlockType, GameConfig::preview_count> next_block_types{};
+    /// 逻辑帧计数
+    size_t logical_frame_count{};
+    /// 分数、连击和 B2B
+    ScoreState score_state{};
+    /// 消除的总行数
     size_t clear_line_count{};
 
-    explicit GameData(std::atomic_size_t *logical_frame_count) : logical_frame_count(logical_frame_count) {}
-    GameData() = delete;
-    ~GameData() = default;
-
-    /// 移动选定的方块。
-    /// @param block 选定要移动的方块
-    /// @param offset 移动的偏移量
-    /// @param refresh_shadow 是否要刷新影子
-    /// @return 是否成功移动了方块。若 check() 不成立，那么实际上不会移动方块，并且返回 false。
-    bool move(block &block, point<int32_t> offset, bool refresh_shadow = true);
-
-    /// 旋转选定的方块。
-    /// @param block 选定要旋转的方块
-    /// @param block_rotation_state
-    /// @param block_type 方块的类型
-    /// @param rotation 旋转角度
-    /// @param refresh_shadow 是否要刷新影子
-    /// @return 是否成功旋转了方块。若 check() 不成立，那么实际上不会旋转方块，并且返回 false。
-    bool rotate(block &block, RotationState &block_rotation_state, BlockType block_type, RotationState rotation,
-                bool refresh_shadow = true);
-
-    /// 生成新的一个或若干个包。
-    /// @param rng 随机数生成器
-    /// @param bag_count 要生成几个包，不填就是一个
-    void new_bag(std::mt19937 &rng, size_t bag_count = 1);
-
-    /// 生成新方块。
-    /// @param block_type 生成新的方块类型。如果不填默认从 next_queue 中拿第一个下来。
-    /// @exception std::runtime_error 当预览块序列为空的时候，抛出这个 exception。
-    void new_block(BlockType block_type = BlockType::None);
-
-    /// 交换暂存块。
-    void exchange_hold();
-
-    /// 检查一个方块的位置是否合法。
-    /// @param block 选定要检查的方块
-    /// @return 检查是否通过
-    bool check(block &block);
-
-    /// 刷新影子方块。
-    void refresh_shadow();
-
-    /// 锁定当前方块。
-    void lock();
-
-    /// 硬降。
-    void hard_drop();
-
-    /// 逻辑帧。处理逻辑的主要地方。
-    void logic_frame(const boost::system::error_code &error_code, boost::asio::steady_timer *timer,
-                     std::atomic_size_t *logical_frame_count, std::mt19937 &rng,
-                     const std::shared_ptr<Keyboard> &keyboard, std::mutex *keyboard_mutex,
-                     std::atomic_flag *flag_thread_quit);
+    /// 是否有对手，对战连上之后才有
+    bool has_opponent{};
+    /// 对手场地的颜色平面
+    decltype(GameData::matrix_color) opponent_matrix_color{};
+    /// 对手的当前方块
+    block opponent_current_block{};
+    /// 对手的当前方块的类型
+    BlockType opponent_current_block_type{BlockType::None};
+    /// 对战的结果
+    VersusResult versus_result{VersusResult::Playing};
 };
 
 /// 游戏主类。
 class Game {
     /// 游戏数据
     std::shared_ptr<GameData> game_data_;
-    /// 键盘状态
+    /// 键盘状态。渲染线程只往里放事件，逻辑线程取事件、查询状态
     std::shared_ptr<Keyboard> keyboard_;
-    /// 键盘状态的锁
-    std::mutex keyboard_mutex_;
     /// 字体，由 main 传过来
     std::shared_ptr<sf::Font> font_;
     /// 要渲染的窗口，从 main 传过来
@@ -337,22 +82,74 @@ class Game {
     /// 渲染帧计数
     size_t frame_count_{};
 
-    /// 逻辑帧计数
-    std::atomic_size_t logical_frame_count_{};
+    /// 这一局的录像，只由逻辑线程写入
+    Replay replay_;
+
+    /// 机器人。为空时由键盘操作
+    std::unique_ptr<Bot> bot_;
+    /// 机器人正在操作的是第几个方块
+    size_t bot_piece_id_{SIZE_MAX};
+    /// 机器人开始思考这个方块时的逻辑帧
+    size_t bot_piece_frame_{};
+    /// 放下之前从方块现在的位置重新规划用的移动生成器，有机器人时才有
+    std::unique_ptr<MoveGenerator> bot_move_generator_;
+
+    /// 在逻辑线程上驱动机器人：新方块出现时提交局面，思考够了就从方块现在的位置重新规划到它选的落点，然后放下。
+    void drive_bot_();
+
+    /// 对手在哪里。为空时是单人游戏
+    std::optional<VersusEndpoint> versus_endpoint_;
+    /// 对战的一方和它的连接，只由逻辑线程访问，连上对手之后才有
+    std::unique_ptr<VersusMatch> versus_match_;
+    std::unique_ptr<VersusConnection> versus_connection_;
+    /// 上一帧的对战结果，用来在结果变化时写日志
+    VersusResult versus_result_{VersusResult::Playing};
+
+    /// 观战服务器监听的端口。为空时不开观战
+    std::optional<uint16_t> spectator_port_;
+    /// 观战服务器，只由逻辑线程访问
+    std::unique_ptr<SpectatorServer> spectator_server_;
+
+    /// 逻辑帧的调度器，只由逻辑线程访问
+    TickScheduler tick_scheduler_;
+
+    /// 一个逻辑帧。从键盘采样这一帧的输入，交给 GameData::step() 推进一帧，再发布快照。
+    void tick_();
+
+    /// 逻辑线程发布给渲染线程的快照
+    TripleBuffer<RenderSnapshot> snapshots_;
+    /// 已经发布、但渲染线程还没取走的快照里累计的有变化的行，只由逻辑线程访问
+    uint32_t unread_dirty_rows_{};
+
+    /// 把 game_data_ 中渲染要用的部分写进快照并发布。每个逻辑帧调用一次。
+    void publish_snapshot_();
     /// 逻辑线程
     std::thread logical_thread_;
 
 public:
     Game() = delete;
 
-    explicit Game(sf::RenderWindow *render_window, std::shared_ptr<sf::Font> font);
+    /// @param render_window 要渲染的窗口
+    /// @param font 字体
+    /// @param use_bot 是否由机器人来玩
+    /// @param versus_endpoint 对战的对手在哪里，为空时是单人游戏。不能和 use_bot 一起用
+    /// @param spectator_port 观战服务器监听的端口，为空时不开观战
+    explicit Game(sf::RenderWindow *render_window, std::shared_ptr<sf::Font> font, bool use_bot = false,
+                  std::optional<VersusEndpoint> versus_endpoint = std::nullopt,
+                  std::optional<uint16_t> spectator_port = std::nullopt);
 
     ~Game() = default;
 
+    /// 计时器唤醒时调用。按 TickScheduler 算出的帧数跑 tick_()，然后等到下一帧的截止时间。
+    /// @param error_code asio 传过来的错误码
+    /// @param timer 逻辑帧的计时器
+    /// @param flag_thread_quit 指示线程退出的 std::atomic_flag
+    void logic_frame(const boost::system::error_code &error_code, boost::asio::steady_timer *timer,
+                     std::atomic_flag *flag_thread_quit);
+
     /// 管理逻辑线程。
-    /// @param rng 随机数生成器
     /// @param flag_thread_quit 指示线程退出的 std::atomic_flag
-    void handle_game_logic(std::mt19937 &rng, std::atomic_flag *flag_thread_quit);
+    void handle_game_logic(std::atomic_flag *flag_thread_quit);
 
     /// 运行游戏。
     void run();
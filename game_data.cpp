@@ -0,0 +1,569 @@
+#include "game_data.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <ranges>
+#include <stdexcept>
+
+#include "profiler.h"
+#include "tick_log.h"
+
+
+bool block::operator==(const block &block) const {
+    return this->points == block.points && this->anchor == block.anchor;
+}
+
+void FrameInput::set_key(const InputKey key, const bool is_pressed, const bool is_pressing) {
+    const auto bit = static_cast<uint8_t>(1u << static_cast<uint8_t>(key));
+    pressed = is_pressed ? pressed | bit : pressed & ~bit;
+    pressing = is_pressing ? pressing | bit : pressing & ~bit;
+}
+
+bool FrameInput::is_key_pressed(const InputKey key) const {
+    return (pressed >> static_cast<uint8_t>(key) & 1u) != 0;
+}
+
+bool FrameInput::is_key_pressing(const InputKey key) const {
+    return (pressing >> static_cast<uint8_t>(key) & 1u) != 0;
+}
+
+bool GameData::move(block &block, const point<int32_t> offset, const bool refresh_shadow) {
+    temp_block = block;
+    for (auto &[y, x]: block.points) {
+        y += offset.y;
+        x += offset.x;
+    }
+    block.anchor.y += offset.y;
+    block.anchor.x += offset.x;
+    if (!check(block)) {
+        block = temp_block;
+        return false;
+    }
+    if (&block == &current_block) {
+        // 移动成功了，最后一次操作就不是旋转了
+        last_rotation_kick = -1;
+    }
+    if (refresh_shadow) {
+        this->refresh_shadow();
+    }
+    return true;
+}
+
+bool GameData::rotate(block &block, RotationState &block_rotation_state, const BlockType block_type,
+                      const RotationState rotation, const bool refresh_shadow) {
+    RotationState new_state;
+    switch (rotation) {
+        case RotationState::Left:
+            new_state = static_cast<RotationState>((static_cast<int>(block_rotation_state) + 3) % 4);
+            break;
+        case RotationState::Right:
+            new_state = static_cast<RotationState>((static_cast<int>(block_rotation_state) + 1) % 4);
+            break;
+        default:
+            throw std::invalid_argument("Invalid rotation type");
+    }
+
+    // 旋转后的形状和踢墙偏移都是编译期算好的，这里只需要查表再加上偏移
+    const auto &[count, offsets] = kick_table[static_cast<size_t>(block_type)][static_cast<size_t>(
+            block_rotation_state)][static_cast<size_t>(new_state)];
+    for (size_t idx = 0; idx < count; idx++) {
+        const auto rotated_block = make_block(block_type, new_state,
+                                              {block.anchor.y + offsets[idx].y, block.anchor.x + offsets[idx].x});
+        if (check(rotated_block)) {
+            block = rotated_block;
+            block_rotation_state = new_state;
+            if (&block == &current_block) {
+                last_rotation_kick = static_cast<int32_t>(idx);
+            }
+            if (refresh_shadow) {
+                this->refresh_shadow();
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GameData::new_bag(const size_t bag_count) {
+    for (size_t i = 0; i < bag_count; i++) {
+        std::array bag{BlockType::I, BlockType::J, BlockType::L, BlockType::O,
+                       BlockType::S, BlockType::Z, BlockType::T};
+        // Fisher-Yates。不用 std::shuffle，它的结果因标准库而异
+        for (auto idx = static_cast<uint32_t>(bag.size()) - 1; idx > 0; idx--) {
+            std::swap(bag[idx], bag[uniform_below(rng, idx + 1)]);
+        }
+        for (const auto block_type: bag) {
+            next_queue.push_back(block_type);
+        }
+    }
+}
+
+void GameData::new_block(const BlockType block_type) {
+    BlockType type;
+    [[likely]]
+    if (block_type == BlockType::None) {
+        if (next_queue.empty()) {
+            // 连预览块都不给我，我怎么生成啊？
+            throw std::runtime_error("Member `next_queue` is empty.");
+        }
+        type = next_queue.front();
+        next_queue.pop_front();
+    } else {
+        type = block_type;
+    }
+
+    current_block = make_block(type, RotationState::Zero, spawn_anchor);
+    current_block_type = type;
+    if (!check(current_block)) {
+        topped_out = true;
+    }
+    current_block_rotation_state = RotationState::Zero;
+    last_rotation_kick = -1;
+    can_exchange_hold = true;
+    on_land = false;
+    scheduled_frame_stamp_down.set_frame_stamp(logical_frame_count);
+    scheduled_frame_stamp_down.set_state(ScheduledState::Loop);
+    this->refresh_shadow();
+}
+
+void GameData::exchange_hold() {
+    if (!can_exchange_hold) {
+        return;
+    }
+
+    const auto temp = current_block_type;
+    current_block_type = hold_block_type;
+    hold_block_type = temp;
+
+    // 如果 current_block_type 是 None 的话（意味着 hold 本来是 None），传给 new_block 生成一个新的；
+    // 如果不是，也传给它。
+    new_block(current_block_type);
+
+    can_exchange_hold = !can_exchange_hold;
+}
+
+bool GameData::check(const block &block) const {
+    return std::ranges::all_of(block.points, [this](auto point) {
+        return 0 <= point.x && point.x < static_cast<int32_t>(width) && 0 <= point.y &&
+               point.y < height_main + height_buffer && (matrix[point.y] >> point.x & 1u) == 0;
+    });
+}
+
+int32_t GameData::drop_distance(const block &block) const {
+    auto distance = static_cast<int32_t>(height_main + height_buffer);
+    for (const auto &[y, x]: block.points) {
+        if (y < column_heights[x]) {
+            // 这一格在表面之下，下面可能有悬空的地方，只能一格一格地试
+            auto probe = block;
+            for (distance = 0;; distance++) {
+                for (auto &point: probe.points) {
+                    point.y--;
+                }
+                if (!check(probe)) {
+                    return distance;
+                }
+            }
+        }
+        distance = std::min(distance, y - column_heights[x]);
+    }
+    return distance;
+}
+
+void GameData::update_column_heights() {
+    uint16_t covered = 0;
+    column_heights.fill(0);
+    for (auto y = height_main + height_buffer - 1; y >= 0 && covered != full_row; y--) {
+        for (auto fresh = static_cast<uint16_t>(matrix[y] & ~covered); fresh != 0; fresh &= fresh - 1) {
+            column_heights[std::countr_zero(fresh)] = y + 1;
+        }
+        covered |= matrix[y];
+    }
+}
+
+void GameData::update_matrix_hash() {
+    matrix_hash = 0;
+    for (size_t y = 0; y < matrix.size(); y++) {
+        matrix_hash ^= Zobrist::row(y, matrix[y]);
+    }
+}
+
+uint64_t GameData::hash() const {
+    return matrix_hash ^
+           Zobrist::current_block(current_block_type, current_block_rotation_state, current_block.anchor.y,
+                                  current_block.anchor.x) ^
+           Zobrist::hold(hold_block_type, can_exchange_hold) ^
+           Zobrist::queue_head(next_queue.empty() ? BlockType::None : next_queue.front());
+}
+
+SpinType GameData::detect_spin(const decltype(matrix) &matrix, const BlockType block_type,
+                               const RotationState rotation_state, const point<int32_t> anchor,
+                               const int32_t last_rotation_kick) {
+    if (block_type != BlockType::T || last_rotation_kick < 0) {
+        return SpinType::None;
+    }
+    // 每一格往高位挪一位，给两边的墙各留一位；地板下面整行都是满的，缓冲区上面只有墙
+    constexpr uint32_t walls = 1u | 1u << (width + 1);
+    const auto padded_row = [&matrix](const int32_t y) -> uint32_t {
+        if (y < 0) {
+            return UINT32_MAX;
+        }
+        if (y >= height_main + height_buffer) {
+            return walls;
+        }
+        return static_cast<uint32_t>(matrix[y]) << 1 | walls;
+    };
+    // T 的中心在锚点右边一格，四个旋转状态都一样。移位之后中心左边的列在第 0 位、右边的列在第 2 位，
+    // 所以角的掩码第 0 位是左上、第 1 位是左下、第 2 位是右上、第 3 位是右下
+    const auto center_x = anchor.x + 1;
+    const auto corners = (padded_row(anchor.y + 1) >> center_x & 0b0101) |
+                         (padded_row(anchor.y - 1) >> center_x & 0b0101) << 1;
+    if (std::popcount(corners) < 3) {
+        return SpinType::None;
+    }
+    // T 尖那一边的两个角：朝上、朝右、朝下、朝左
+    constexpr std::array<uint32_t, 4> front_corners{0b0101, 0b1100, 0b1010, 0b0011};
+    const auto front = front_corners[static_cast<size_t>(rotation_state)];
+    if ((corners & front) == front || last_rotation_kick == triple_kick) {
+        return SpinType::Full;
+    }
+    return SpinType::Mini;
+}
+
+void GameData::refresh_shadow() {
+    shadow_block = current_block;
+    const auto distance = drop_distance(current_block);
+    for (auto &[y, x]: shadow_block.points) {
+        y -= distance;
+    }
+    shadow_block.anchor.y -= distance;
+}
+
+void GameData::lock() {
+    locked_spin = detect_spin(matrix, current_block_type, current_block_rotation_state, current_block.anchor,
+                              last_rotation_kick);
+    lock_pending = true;
+    for (auto &[y, x]: current_block.points) {
+        matrix[y] |= static_cast<uint16_t>(1u << x);
+        matrix_color[y][x] = current_block_type;
+        matrix_hash ^= Zobrist::cell(static_cast<size_t>(y), static_cast<size_t>(x));
+        dirty_rows |= 1u << y;
+        column_heights[x] = std::max(column_heights[x], y + 1);
+    }
+    piece_count++;
+    new_block();
+}
+
+void GameData::hard_drop() {
+    if (const auto distance = current_block.anchor.y - shadow_block.anchor.y; distance > 0) {
+        // 硬降每格 2 分。落下了至少一格，最后一次操作就不是旋转了
+        score_state.score += 2 * static_cast<uint64_t>(distance);
+        last_rotation_kick = -1;
+    }
+    current_block = shadow_block;
+    lock();
+}
+
+size_t GameData::clear_lines() {
+    constexpr size_t height = height_main + height_buffer;
+    size_t count = 0;
+    for (size_t y = 0; y < height; y++) {
+        if (matrix[y] == full_row) {
+            if (count == 0) {
+                // 从第一个被消除的行开始，上面的每一行都变了
+                dirty_rows |= ((1u << height) - 1) & ~((1u << y) - 1);
+            }
+            matrix_hash ^= Zobrist::row(y, matrix[y]);
+            count++;
+        } else if (count != 0) {
+            // 这一行换了位置，它的格子的键也跟着换
+            matrix_hash ^= Zobrist::row(y, matrix[y]) ^ Zobrist::row(y - count, matrix[y]);
+            matrix[y - count] = matrix[y];
+            matrix_color[y - count] = matrix_color[y];
+        }
+    }
+    // 压下来之后，最上面的 count 行一定是空的
+    for (size_t y = height - count; y < height; y++) {
+        matrix[y] = 0;
+        std::ranges::fill(matrix_color[y], BlockType::None);
+    }
+    if (count != 0) {
+        // 消行之后各列的高度降多少不一定（下面可能有空洞），重新算一遍
+        update_column_heights();
+    }
+    return count;
+}
+
+void GameData::receive_garbage(const uint32_t lines) { incoming_garbage += lines; }
+
+void GameData::insert_garbage(const size_t lines, const size_t hole_column) {
+    constexpr size_t height = height_main + height_buffer;
+    const auto shift = std::min(lines, height);
+    for (size_t y = height; y-- > height - shift;) {
+        if (matrix[y] != 0) {
+            topped_out = true;
+        }
+    }
+    for (size_t y = height; y-- > shift;) {
+        matrix[y] = matrix[y - shift];
+        matrix_color[y] = matrix_color[y - shift];
+    }
+    const auto garbage_row = static_cast<uint16_t>(full_row & ~(1u << hole_column));
+    for (size_t y = 0; y < shift; y++) {
+        matrix[y] = garbage_row;
+        matrix_color[y].fill(BlockType::Garbage);
+        matrix_color[y][hole_column] = BlockType::None;
+    }
+    dirty_rows |= (1u << height) - 1;
+    update_column_heights();
+    update_matrix_hash();
+    // 当前方块原地不动，被顶上来的格子占了也算死
+    if (!check(current_block)) {
+        topped_out = true;
+    }
+    refresh_shadow();
+}
+
+void GameData::start() {
+    new_bag(2);
+    new_block();
+}
+
+void GameData::step(const FrameInput &input) {
+    ZEETRIS_PROFILE_SCOPE("step");
+
+    {
+        ZEETRIS_PROFILE_SCOPE("step.input");
+        bool move_changed = false;
+        if (input.is_key_pressed(InputKey::Left)) {
+            state_move_left = state_move_right + 1;
+            move_changed = true;
+        } else if (!input.is_key_pressing(InputKey::Left) && state_move_left != 0) {
+            state_move_left = 0;
+            move_changed = true;
+        }
+        if (input.is_key_pressed(InputKey::Right)) {
+            state_move_right = state_move_left + 1;
+            move_changed = true;
+        } else if (!input.is_key_pressing(InputKey::Right) && state_move_right != 0) {
+            state_move_right = 0;
+            move_changed = true;
+        }
+
+        if (move_changed) {
+            if (state_move_left == state_move_right) {
+                scheduled_frame_stamp_move.set_state(ScheduledState::Inactive);
+                move_offset.x = 0;
+            } else {
+                ZEETRIS_TICK_LOG_DEBUG("Move started at frame {}", logical_frame_count);
+                scheduled_frame_stamp_move.set_state(ScheduledState::Loop);
+                scheduled_frame_stamp_move.set_frame_stamp(logical_frame_count);
+                scheduled_frame_stamp_move.set_duration(GameConfig::DAS);
+                scheduled_frame_stamp_move.set_next_duration(std::make_optional(GameConfig::ARR));
+                move_offset.x = state_move_left > state_move_right ? -1 : 1;
+                // 按下的那一瞬间也是要移动的
+                move(current_block, move_offset);
+            }
+        }
+    }
+
+    {
+        ZEETRIS_PROFILE_SCOPE("step.move_rotate");
+        if (input.is_key_pressed(InputKey::RotateLeft)) {
+            rotate(current_block, current_block_rotation_state, current_block_type, RotationState::Left);
+        }
+        if (input.is_key_pressed(InputKey::RotateRight)) {
+            rotate(current_block, current_block_rotation_state, current_block_type, RotationState::Right);
+        }
+        if (input.is_key_pressed(InputKey::HardDrop)) {
+            hard_drop();
+        }
+        if (input.is_key_pressed(InputKey::Hold)) {
+            exchange_hold();
+        }
+        if (input.is_key_pressed(InputKey::SoftDrop)) {
+            scheduled_frame_stamp_down.set_duration(std::min(GameConfig::soft_down_delay, down_delay()));
+        } else if (!input.is_key_pressing(InputKey::SoftDrop)) {
+            scheduled_frame_stamp_down.set_duration(down_delay());
+        }
+
+        if (scheduled_frame_stamp_move.on_update(logical_frame_count)) {
+            move(current_block, move_offset);
+        }
+    }
+
+    {
+        ZEETRIS_PROFILE_SCOPE("step.lock_gravity");
+        // 着地 / 锁定逻辑
+        if (shadow_block == current_block && !scheduled_frame_stamp_lock.is_active()) {
+            scheduled_frame_stamp_lock.set_active(logical_frame_count);
+            scheduled_frame_stamp_down.set_state(ScheduledState::Inactive);
+        } else if (shadow_block != current_block && scheduled_frame_stamp_lock.is_active()) {
+            scheduled_frame_stamp_lock.set_state(ScheduledState::Inactive);
+            scheduled_frame_stamp_down.set_frame_stamp(logical_frame_count);
+            scheduled_frame_stamp_down.set_state(ScheduledState::Loop);
+        }
+        if (scheduled_frame_stamp_lock.on_update(logical_frame_count)) {
+            lock();
+        }
+
+        // 下落逻辑
+        if (scheduled_frame_stamp_down.on_update(logical_frame_count)) {
+            if (move(current_block, {-1, 0}) && input.is_key_pressing(InputKey::SoftDrop)) {
+                // 软降每格 1 分
+                score_state.score++;
+            }
+        }
+    }
+
+    // 处理消行逻辑
+    {
+        ZEETRIS_PROFILE_SCOPE("step.line_clear");
+        const size_t count = clear_lines();
+        const auto locked = lock_pending;
+        if (locked) {
+            // 上一次 step() 之后锁定了方块，按这次锁定计分。等级按消行之前的算
+            lock_pending = false;
+            const auto perfect_clear = count > 0 && std::ranges::all_of(matrix, [](const uint16_t row) {
+                return row == 0;
+            });
+            last_score_event = score_state.lock({static_cast<uint32_t>(count), locked_spin, perfect_clear}, level());
+        }
+        if (count > 0) {
+            clear_line_count += count;
+            ZEETRIS_TICK_LOG_INFO("Cleared {} lines, {} in total", count, clear_line_count);
+            refresh_shadow();
+
+            // 消行只会发生在锁定之后，攻击就是这次锁定的。先抵消收到的垃圾，剩下的才打给对手
+            const auto attack = last_score_event.attack;
+            const auto cancelled = std::min(attack, incoming_garbage);
+            incoming_garbage -= cancelled;
+            outgoing_attack += attack - cancelled;
+            attack_line_count += attack;
+        } else if (locked && incoming_garbage != 0) {
+            // 锁定了方块但没有消行，收到的垃圾都插进来
+            ZEETRIS_PROFILE_SCOPE("step.garbage");
+            insert_garbage(incoming_garbage, uniform_below(garbage_rng, width));
+            incoming_garbage = 0;
+        }
+    }
+
+    // 预览块序列不足时，生成新的包
+    if (next_queue.size() <= 7) {
+        ZEETRIS_PROFILE_SCOPE("step.new_bag");
+        new_bag();
+    }
+
+    logical_frame_count++;
+}
+
+GameSnapshot GameData::save() const {
+    return {current_block,
+            current_block_rotation_state,
+            current_block_type,
+            hold_block_type,
+            can_exchange_hold,
+            on_land,
+            topped_out,
+            next_queue,
+            matrix,
+            matrix_color,
+            logical_frame_count,
+            rng,
+            garbage_rng,
+            scheduled_frame_stamp_lock,
+            scheduled_frame_stamp_down,
+            scheduled_frame_stamp_move,
+            state_move_left,
+            state_move_right,
+            move_offset,
+            clear_line_count,
+            piece_count,
+            incoming_garbage,
+            outgoing_attack,
+            attack_line_count,
+            matrix_hash,
+            score_state,
+            last_score_event,
+            last_rotation_kick,
+            locked_spin,
+            lock_pending};
+}
+
+void GameData::restore(const GameSnapshot &snapshot) {
+    // 逐个 BlockType 比较太慢了，按字节比较。回滚的时候场地大多没变，先整个比一次
+    if (std::memcmp(&matrix_color, &snapshot.matrix_color, sizeof(matrix_color)) != 0) {
+        for (size_t y = 0; y < matrix_color.size(); y++) {
+            if (std::memcmp(matrix_color[y].data(), snapshot.matrix_color[y].data(), sizeof(matrix_color[y])) != 0) {
+                dirty_rows |= 1u << y;
+            }
+        }
+    }
+
+    current_block = snapshot.current_block;
+    current_block_rotation_state = snapshot.current_block_rotation_state;
+    current_block_type = snapshot.current_block_type;
+    hold_block_type = snapshot.hold_block_type;
+    can_exchange_hold = snapshot.can_exchange_hold;
+    on_land = snapshot.on_land;
+    topped_out = snapshot.topped_out;
+    next_queue = snapshot.next_queue;
+    matrix = snapshot.matrix;
+    matrix_color = snapshot.matrix_color;
+    logical_frame_count = snapshot.logical_frame_count;
+    rng = snapshot.rng;
+    garbage_rng = snapshot.garbage_rng;
+    scheduled_frame_stamp_lock = snapshot.scheduled_frame_stamp_lock;
+    scheduled_frame_stamp_down = snapshot.scheduled_frame_stamp_down;
+    scheduled_frame_stamp_move = snapshot.scheduled_frame_stamp_move;
+    state_move_left = snapshot.state_move_left;
+    state_move_right = snapshot.state_move_right;
+    move_offset = snapshot.move_offset;
+    clear_line_count = snapshot.clear_line_count;
+    piece_count = snapshot.piece_count;
+    incoming_garbage = snapshot.incoming_garbage;
+    outgoing_attack = snapshot.outgoing_attack;
+    attack_line_count = snapshot.attack_line_count;
+    matrix_hash = snapshot.matrix_hash;
+    score_state = snapshot.score_state;
+    last_score_event = snapshot.last_score_event;
+    last_rotation_kick = snapshot.last_rotation_kick;
+    locked_spin = snapshot.locked_spin;
+    lock_pending = snapshot.lock_pending;
+
+    update_column_heights();
+    refresh_shadow();
+}
+
+std::optional<size_t> GameData::next_event_frame() const {
+    std::optional<size_t> next_frame;
+    // 只有三个计划帧，直接取最小的就是优先队列了
+    for (const auto *frame_stamp: {&scheduled_frame_stamp_move, &scheduled_frame_stamp_lock,
+                                   &scheduled_frame_stamp_down}) {
+        if (const auto frame = frame_stamp->next_frame(); frame.has_value()) {
+            next_frame = next_frame.has_value() ? std::min(*next_frame, *frame) : *frame;
+        }
+    }
+    return next_frame;
+}
+
+bool GameData::is_idle_() const {
+    // 松开所有键之后的第一帧会停掉自动移动、恢复下落速度；
+    // 着地或离地之后的第一帧会切换锁定和下落。这些都做完了，剩下的就只有计划帧了
+    return state_move_left == 0 && state_move_right == 0 && !scheduled_frame_stamp_move.is_active() &&
+           scheduled_frame_stamp_down.duration() == down_delay() &&
+           (shadow_block == current_block) == scheduled_frame_stamp_lock.is_active() && next_queue.size() > 7;
+}
+
+void GameData::step_idle(const size_t frame_count) {
+    const auto target = logical_frame_count + frame_count;
+    while (logical_frame_count < target) {
+        step(FrameInput{});
+        if (is_idle_()) {
+            // 直接跳到下一个计划帧到期的那一帧，那一帧本身还是要 step() 的
+            const auto next_frame = next_event_frame().value_or(target);
+            logical_frame_count = std::clamp(next_frame, logical_frame_count, target);
+        }
+    }
+}
@@ -0,0 +1,581 @@
+#ifndef GAME_DATA_H
+#define GAME_DATA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "piece_queue.h"
+#include "rng.h"
+#include "scheduled_frame_stamp.h"
+#include "scoring.h"
+#include "zobrist.h"
+
+
+/// 表示一个点 / 一个坐标。由于这个项目的特殊性，先存储 y 再存储 x，要与 SFML 中通行的 (x, y) 存储方式区别开来。
+template<typename T>
+class point {
+public:
+    T y, x;
+
+    bool operator==(const point<T> &point) const = default;
+};
+
+/// 一个方块。
+class block {
+public:
+    /// 表示每个点的坐标
+    std::array<point<int32_t>, 4> points;
+
+    /// 锚点所在。用于超级旋转系统。
+    point<int32_t> anchor{0, 0};
+
+    bool operator==(const block &block) const;
+};
+
+/// 预设值，表示每个方块对应的 4 个点的坐标。
+static constexpr std::array blocks{
+        block{
+                point{0, 0},
+                {0, 0},
+                {0, 0},
+                {0, 0},
+        },
+
+        block{
+                point{0, 0},
+                {0, 1},
+                {0, 2},
+                {0, 3},
+        }, // I
+        block{
+                point{0, 0},
+                {1, 0},
+                {0, 1},
+                {0, 2},
+        }, // J
+        block{
+                point{0, 0},
+                {0, 1},
+                {0, 2},
+                {1, 2},
+        }, // L
+        block{
+                point{0, 1},
+                {0, 2},
+                {1, 1},
+                {1, 2},
+        }, // O
+        block{
+                point{0, 0},
+                {0, 1},
+                {1, 1},
+                {1, 2},
+        }, // S
+        block{
+                point{1, 0},
+                {1, 1},
+                {0, 1},
+                {0, 2},
+        }, // Z
+        block{
+                point{0, 0},
+                {0, 1},
+                {0, 2},
+                {1, 1},
+        }, // T
+};
+
+/// 方块类型。默认应该是 None (0)。
+enum class BlockType : int8_t {
+    Unknown = -1,
+    None = 0,
+    I,
+    J,
+    L,
+    O,
+    S,
+    Z,
+    T,
+    /// 垃圾行。只会出现在场地的颜色平面里，不是一种方块
+    Garbage,
+};
+
+/// 预设值，表示一种方块对应的旋转中心（相对于锚点），以 rotating_centers[方块类型] 的方式访问。
+static constexpr std::array rotating_centers{
+        point{0.f, 0.f},  point{-0.5f, 1.5f}, point{0.f, 1.f}, point{0.f, 1.f},
+        point{0.5f, 1.5f}, point{0.f, 1.f},   point{0.f, 1.f}, point{0.f, 1.f},
+};
+
+/// 旋转的状态 / 方向。
+///
+/// 当表示旋转的方向的时候，Zero 是没有意义的。
+enum class RotationState {
+    /// 初始状态
+    Zero = 0,
+    /// 初始态顺时针旋转（右转）后的状态 / 顺时针旋转
+    Right = 1,
+    /// 初始态旋转 180° 后的状态 / 180° 旋转
+    Two = 2,
+    /// 初始态逆时针旋转（左转）后的状态 / 逆时针旋转
+    Left = 3,
+};
+
+/// 方块的形状，即 4 个点相对于锚点的坐标。
+using shape = std::array<point<int32_t>, 4>;
+
+/// 预设值，表示每种方块在每个旋转状态下的形状，以 block_shapes[方块类型][旋转状态] 的方式访问。
+///
+/// 在编译期把 blocks 绕 rotating_centers 顺时针转出来。用两倍的坐标计算，这样 .5 的旋转中心也是整数。
+static constexpr auto block_shapes = [] {
+    std::array<std::array<shape, 4>, blocks.size()> shapes{};
+    for (size_t type = 0; type < blocks.size(); type++) {
+        const auto center_y2 = static_cast<int32_t>(rotating_centers[type].y * 2.f);
+        const auto center_x2 = static_cast<int32_t>(rotating_centers[type].x * 2.f);
+        shapes[type][0] = blocks[type].points;
+        for (size_t state = 1; state < 4; state++) {
+            for (size_t idx = 0; idx < 4; idx++) {
+                const auto [y, x] = shapes[type][state - 1][idx];
+                shapes[type][state][idx] = {(center_y2 - (2 * x - center_x2)) / 2,
+                                            (center_x2 + (2 * y - center_y2)) / 2};
+            }
+        }
+    }
+    return shapes;
+}();
+
+/// 根据方块类型、旋转状态和锚点构造一个方块。
+/// @param block_type 方块类型
+/// @param rotation_state 旋转状态
+/// @param anchor 锚点
+/// @return 构造出的方块
+constexpr block make_block(const BlockType block_type, const RotationState rotation_state,
+                           const point<int32_t> anchor) {
+    block result{{}, anchor};
+    const auto &block_shape = block_shapes[static_cast<size_t>(block_type)][static_cast<size_t>(rotation_state)];
+    for (size_t idx = 0; idx < 4; idx++) {
+        result.points[idx] = {anchor.y + block_shape[idx].y, anchor.x + block_shape[idx].x};
+    }
+    return result;
+}
+
+/// 一次旋转要依次尝试的踢墙偏移。
+class kick_list {
+public:
+    /// 有效的偏移个数。为 0 表示不能这样旋转。
+    size_t count;
+    /// 偏移，和 point 一样先存 y 再存 x。
+    std::array<point<int32_t>, 5> offsets;
+};
+
+/// 踢墙表，以 kickwall[旋转前的状态][旋转后的状态] 的方式访问。
+using kickwall = std::array<std::array<kick_list, 4>, 4>;
+
+/// JLSTZ 的踢墙表
+static constexpr kickwall kickwall_JLSTZ = [] {
+    kickwall table{};
+    table[0][1] = {5, {point{0, 0}, {0, -1}, {+1, -1}, {-2, 0}, {-2, -1}}};
+    table[1][0] = {5, {point{0, 0}, {0, +1}, {-1, +1}, {+2, 0}, {+2, +1}}};
+    table[1][2] = {5, {point{0, 0}, {0, +1}, {-1, +1}, {+2, 0}, {+2, +1}}};
+    table[2][1] = {5, {point{0, 0}, {0, -1}, {+1, -1}, {-2, 0}, {-2, -1}}};
+    table[2][3] = {5, {point{0, 0}, {0, +1}, {+1, +1}, {-2, 0}, {-2, +1}}};
+    table[3][2] = {5, {point{0, 0}, {0, -1}, {-1, -1}, {+2, 0}, {+2, -1}}};
+    table[3][0] = {5, {point{0, 0}, {0, -1}, {-1, -1}, {+2, 0}, {+2, -1}}};
+    table[0][3] = {5, {point{0, 0}, {0, +1}, {+1, +1}, {-2, 0}, {-2, +1}}};
+    return table;
+}();
+
+/// I 的踢墙表
+static constexpr kickwall kickwall_I = [] {
+    kickwall table{};
+    table[0][1] = {5, {point{0, 0}, {0, -2}, {0, +1}, {-1, -2}, {+2, +1}}};
+    table[1][0] = {5, {point{0, 0}, {0, +2}, {0, -1}, {+1, +2}, {-2, -1}}};
+    table[1][2] = {5, {point{0, 0}, {0, -1}, {0, +2}, {+2, -1}, {-1, +2}}};
+    table[2][1] = {5, {point{0, 0}, {0, +1}, {0, -2}, {-2, +1}, {+1, -2}}};
+    table[2][3] = {5, {point{0, 0}, {0, +2}, {0, -1}, {+1, +2}, {-2, -1}}};
+    table[3][2] = {5, {point{0, 0}, {0, -2}, {0, +1}, {-1, -2}, {+2, +1}}};
+    table[3][0] = {5, {point{0, 0}, {0, +1}, {0, -2}, {-2, +1}, {+1, -2}}};
+    table[0][3] = {5, {point{0, 0}, {0, -1}, {0, +2}, {+2, -1}, {-1, +2}}};
+    return table;
+}();
+
+/// O 的踢墙表（实际上没有）
+static constexpr kickwall kickwall_O{};
+
+/// 预设值，表示每种方块的踢墙表，以 kick_table[方块类型][旋转前的状态][旋转后的状态] 的方式访问。
+static constexpr auto kick_table = [] {
+    std::array<kickwall, blocks.size()> table{};
+    for (size_t type = 0; type < blocks.size(); type++) {
+        switch (static_cast<BlockType>(type)) {
+            case BlockType::I:
+                table[type] = kickwall_I;
+                break;
+            case BlockType::O:
+                table[type] = kickwall_O;
+                break;
+            case BlockType::None:
+            case BlockType::Unknown:
+                break;
+            default:
+                table[type] = kickwall_JLSTZ;
+                break;
+        }
+    }
+    return table;
+}();
+
+/// 游戏设置
+class GameConfig {
+public:
+    /// 渲染相关：方块大小
+    static constexpr float block_size = 25.f;
+    /// 渲染相关：显示几个预览块
+    static constexpr size_t preview_count = 5;
+
+    /// 逻辑相关：等级 1 的下降延迟 (frame / 60 frames)
+    static constexpr size_t down_delay = 60;
+    /// 逻辑相关：每个等级的下降延迟，以 level_down_delays[等级 - 1] 的方式访问 (frame / 60 frames)。
+    /// 按准则的 (0.8 - (等级 - 1) * 0.007) ^ (等级 - 1) 秒一格取整，最快一帧一格
+    static constexpr std::array<size_t, ScoreState::max_level> level_down_delays{60, 48, 37, 28, 21, 16, 11, 8,
+                                                                                6,  4,  3,  2,  1,  1,  1};
+    /// 逻辑相关：软降延迟 (frame / 60 frames)
+    static constexpr size_t soft_down_delay = 3;
+    /// 逻辑相关：锁定延迟 (frame / 60 frames)
+    static constexpr size_t lock_delay = 90;
+
+    /// 操作相关：自动移动延迟 (DAS) (frame / 60 frames)
+    static constexpr size_t DAS = 10;
+    /// 操作相关：移动重复延迟 (ARR) (frame / 60 frames)
+    static constexpr size_t ARR = 2;
+
+    /// 机器人相关：每个方块出现之后，机器人思考多久再放下 (frame / 60 frames)
+    static constexpr size_t bot_delay = 15;
+};
+
+/// 游戏中的操作，与具体的键盘按键无关。
+enum class InputKey : uint8_t {
+    Left = 0,
+    Right,
+    RotateLeft,
+    RotateRight,
+    HardDrop,
+    Hold,
+    SoftDrop,
+};
+
+/// 一个逻辑帧的输入。第 n 位对应 InputKey 中值为 n 的操作。
+class FrameInput {
+public:
+    /// 刚被按下的操作
+    uint8_t pressed{};
+    /// 被按着的操作（包括刚被按下的）
+    uint8_t pressing{};
+
+    bool operator==(const FrameInput &frame_input) const = default;
+
+    /// 设定一个操作的状态。
+    /// @param key 要设定的操作
+    /// @param is_pressed 是否刚被按下
+    /// @param is_pressing 是否被按着
+    void set_key(InputKey key, bool is_pressed, bool is_pressing);
+
+    /// 测试一个操作是否刚被按下。
+    /// @param key 要测试的操作
+    /// @return 操作是否刚按下
+    [[nodiscard]] bool is_key_pressed(InputKey key) const;
+    /// 测试一个操作是否被按下。
+    /// @param key 要测试的操作
+    /// @return 操作是否被按下
+    [[nodiscard]] bool is_key_pressing(InputKey key) const;
+};
+
+class GameSnapshot;
+
+/// 用来存储游戏数据的类。一些与游戏数据操作有关的方法也放在这里面，但是不是 static 的。
+class GameData {
+public:
+    /// 当前的方块。注意现在所有的方块都是 4 连方块。
+    block current_block{};
+    /// 影子方块。这个应该是惰性的，就是只有在场地 / 方块更新时才重新计算这个
+    block shadow_block{};
+    /// 备用的方块，这个做什么都可以。
+    block temp_block{};
+
+    /// 当前方块的旋转状态
+    RotationState current_block_rotation_state{RotationState::Zero};
+    /// 当前方块的类型
+    BlockType current_block_type = BlockType::None;
+    /// 暂存块的类型
+    BlockType hold_block_type = BlockType::None;
+
+    /// 预览序列。容量固定的环形队列。
+    PieceQueue next_queue{};
+
+    /// 主场地的高 (y)
+    static constexpr int32_t height_main = 20;
+    /// 缓冲区的高 (y + height_main)
+    static constexpr int32_t height_buffer = 2;
+    /// 场地的宽 (x)
+    static constexpr size_t width = 10;
+
+    /// 新方块出生时的锚点
+    static constexpr point<int32_t> spawn_anchor{20, 3};
+
+    /// 一整行都被占满时的行掩码
+    static constexpr uint16_t full_row = (1u << width) - 1;
+
+    /// 第五个踢墙偏移（TST 踢墙）的下标。用它转进去的 T 总是 T-spin，不会是 Mini
+    static constexpr int32_t triple_kick = 4;
+
+    /// 场地 / 矩阵的占用位图，y = 0 为底。matrix[y] 的第 x 位为 1 表示 (y, x) 被占用。
+    std::array<uint16_t, height_main + height_buffer> matrix{};
+    /// 场地的颜色平面，仅用于渲染，以 matrix_color[y][x] 的方式访问。逻辑判断一律使用 matrix。
+    std::array<std::array<BlockType, width>, height_main + height_buffer> matrix_color{};
+    /// matrix_color 中有变化的行，第 y 位为 1 表示第 y 行变了。只会被置位，由使用者（渲染）取走之后自己清零
+    uint32_t dirty_rows{};
+    /// 每一列的高度，即这一列最高的被占用的格子的 y + 1。由 lock() 和 clear_lines() 维护，
+    /// 直接修改了 matrix 之后要调用 update_column_heights()
+    std::array<int32_t, width> column_heights{};
+    /// matrix 的 Zobrist 哈希，即所有被占用的格子的键的异或。和 column_heights 一样由 lock() 和 clear_lines() 维护，
+    /// 直接修改了 matrix 之后要调用 update_matrix_hash()
+    uint64_t matrix_hash{};
+
+    /// 逻辑帧计数，每次 step() 之后自增
+    size_t logical_frame_count{};
+
+    /// 随机数生成器，用来生成包。同一个种子在所有平台上都会得到同样的方块序列
+    PieceRng rng;
+
+    /// 是否可以交换暂存块
+    bool can_exchange_hold = true;
+    /// 当前方块是否在地上
+    bool on_land = false;
+    /// 如果锁在地上，开始的帧数戳
+    [[deprecated]] size_t frame_stamp_lock{};
+
+    /// 锁定计划帧
+    ScheduledFrameStamp scheduled_frame_stamp_lock{0, GameConfig::lock_delay};
+    /// 下降计划帧
+    ScheduledFrameStamp scheduled_frame_stamp_down{0, GameConfig::down_delay, ScheduledState::Loop};
+
+    /// 移动计划帧
+    ScheduledFrameStamp scheduled_frame_stamp_move{0, GameConfig::DAS};
+    /// 左移的状态。
+    /// 请见代码中对这个变量的具体解释。
+    int32_t state_move_left{0};
+    /// 右移的状态。
+    /// 请见代码中对这个变量的具体解释。
+    int32_t state_move_right{0};
+    /// 移动的偏移
+    /// 请见代码中对这个变量的具体解释。
+    point<int32_t> move_offset{0, 0};
+
+    /// 消除的总行数
+    size_t clear_line_count{};
+    /// 锁定的方块总数
+    size_t piece_count{};
+
+    /// 生成垃圾行缺口的随机数生成器。和生成包的分开，这样收没收到垃圾都不会影响方块序列
+    PieceRng garbage_rng;
+    /// 收到、但还没插入场地的垃圾行数。锁定方块之后没有消行时全部插入；消行时先用攻击抵消
+    uint32_t incoming_garbage{};
+    /// 抵消之后打给对手、还没被取走的行数。由对战的一方取走之后清零
+    uint32_t outgoing_attack{};
+    /// 打给对手的总行数（抵消之前）
+    size_t attack_line_count{};
+    /// 是否已经死了：新方块出生的位置被占了，或者垃圾行把方块顶出了场地
+    bool topped_out{};
+
+    /// 分数、连击和 B2B
+    ScoreState score_state{};
+    /// 最近一次锁定得到的分数和攻击，用来显示
+    ScoreEvent last_score_event{};
+    /// 当前方块最后一次成功的操作是旋转时，它用的是第几个踢墙偏移；最后一次是移动（或者还没动过）时为 -1
+    int32_t last_rotation_kick{-1};
+    /// 最近一次锁定的 T-spin 判定，由 lock() 写下，计分时用
+    SpinType locked_spin{SpinType::None};
+    /// lock() 之后还没有计分。锁定可能发生在 step() 里，也可能发生在外面（机器人的 perform()），
+    /// 都由下一次 step() 消行、计分、插入垃圾
+    bool lock_pending{};
+
+    explicit GameData(const uint64_t seed) : rng(seed), garbage_rng(~seed) {}
+    GameData() = delete;
+    ~GameData() = default;
+
+    /// 移动选定的方块。
+    /// @param block 选定要移动的方块
+    /// @param offset 移动的偏移量
+    /// @param refresh_shadow 是否要刷新影子
+    /// @return 是否成功移动了方块。若 check() 不成立，那么实际上不会移动方块，并且返回 false。
+    bool move(block &block, point<int32_t> offset, bool refresh_shadow = true);
+
+    /// 旋转选定的方块。
+    /// @param block 选定要旋转的方块
+    /// @param block_rotation_state
+    /// @param block_type 方块的类型
+    /// @param rotation 旋转角度
+    /// @param refresh_shadow 是否要刷新影子
+    /// @return 是否成功旋转了方块。若 check() 不成立，那么实际上不会旋转方块，并且返回 false。
+    bool rotate(block &block, RotationState &block_rotation_state, BlockType block_type, RotationState rotation,
+                bool refresh_shadow = true);
+
+    /// 用 rng 生成新的一个或若干个包。
+    /// @param bag_count 要生成几个包，不填就是一个
+    void new_bag(size_t bag_count = 1);
+
+    /// 生成新方块。
+    /// @param block_type 生成新的方块类型。如果不填默认从 next_queue 中拿第一个下来。
+    /// @exception std::runtime_error 当预览块序列为空的时候，抛出这个 exception。
+    void new_block(BlockType block_type = BlockType::None);
+
+    /// 交换暂存块。
+    void exchange_hold();
+
+    /// 检查一个方块的位置是否合法。
+    /// @param block 选定要检查的方块
+    /// @return 检查是否通过
+    [[nodiscard]] bool check(const block &block) const;
+
+    /// 一个方块能往下落多少格。
+    ///
+    /// 方块的每个格子都在所在列的表面之上时，只需要查 4 次 column_heights；
+    /// 有格子在悬空的方块底下（比如 Tuck 进去之后）时，退回到一格一格地往下试。
+    /// @param block 要下落的方块
+    /// @return 下落的格数
+    [[nodiscard]] int32_t drop_distance(const block &block) const;
+
+    /// 根据 matrix 重新计算 column_heights。
+    void update_column_heights();
+
+    /// 根据 matrix 重新计算 matrix_hash。
+    void update_matrix_hash();
+
+    /// 局面的 Zobrist 哈希：场地、当前方块的类型和位置、暂存块和预览序列的队首。
+    ///
+    /// 场地的部分随着锁定和消行增量地维护，其余的部分都只是查几次表，所以随时调用都是 O(1) 的。
+    /// 同样的种子和输入在任何机器上都得到同样的哈希，对战和录像可以每帧比较它来发现不同步。
+    /// @return 哈希
+    [[nodiscard]] uint64_t hash() const;
+
+    /// T-spin 判定（三角规则）。
+    ///
+    /// T 的中心周围的四个角（场地外面也算）至少有三个被占，并且最后一次成功的操作是旋转，才算 T-spin；
+    /// T 尖那一边的两个角只占了一个时是 Mini，除非最后一次旋转用的是第五个踢墙偏移（TST 踢墙）。
+    /// 四个角从两行里各取两位拼成一个掩码，和每个旋转状态的尖的掩码比较，不用逐格检查。
+    /// @param matrix 占用位图，不含这个方块
+    /// @param block_type 方块类型，不是 T 的话总是 None
+    /// @param rotation_state 锁定时的旋转状态
+    /// @param anchor 锁定时的锚点
+    /// @param last_rotation_kick 最后一次旋转用的踢墙偏移的下标，最后一次操作不是旋转时为 -1
+    /// @return 判定结果
+    [[nodiscard]] static SpinType detect_spin(const decltype(matrix) &matrix, BlockType block_type,
+                                              RotationState rotation_state, point<int32_t> anchor,
+                                              int32_t last_rotation_kick);
+
+    /// 当前的等级，由消除的行数决定。
+    [[nodiscard]] uint32_t level() const { return ScoreState::level_of(clear_line_count); }
+
+    /// 当前等级的下降延迟。
+    [[nodiscard]] size_t down_delay() const { return GameConfig::level_down_delays[level() - 1]; }
+
+    /// 刷新影子方块。
+    void refresh_shadow();
+
+    /// 锁定当前方块，同时判定 T-spin，写在 locked_spin 里，由下一次 step() 计分。
+    void lock();
+
+    /// 硬降。
+    void hard_drop();
+
+    /// 收到对手的攻击，在下一次锁定之后没有消行时插入。
+    /// @param lines 垃圾行数
+    void receive_garbage(uint32_t lines);
+
+    /// 在场地底部插入垃圾行，上面的行往上推，推出场地的话就死了。
+    /// @param lines 垃圾行数
+    /// @param hole_column 垃圾行的缺口所在的列，这几行都一样
+    void insert_garbage(size_t lines, size_t hole_column);
+
+    /// 消除所有被占满的行，并把上面的行压下来。
+    /// @return 消除的行数
+    size_t clear_lines();
+
+    /// 开始游戏：生成最初的两个包和第一个方块。
+    void start();
+
+    /// 逻辑帧。处理逻辑的主要地方，同步地推进一帧。
+    /// @param input 这一帧的输入
+    void step(const FrameInput &input);
+
+    /// 下一个计划帧到期的逻辑帧，即锁定、下落、自动移动中最早会发生的那一个。
+    /// @return 没有活动的计划帧时返回 nullopt
+    [[nodiscard]] std::optional<size_t> next_event_frame() const;
+
+    /// 取出完整的模拟状态。
+    /// @return 快照
+    [[nodiscard]] GameSnapshot save() const;
+
+    /// 放回 save() 取出的模拟状态，之后的 step() 和存下快照时的那一局完全一样。
+    ///
+    /// 影子和列高会重新算；颜色变了的行会标记在 dirty_rows 里。
+    /// @param snapshot 快照
+    void restore(const GameSnapshot &snapshot);
+
+    /// 没有输入地推进若干帧。
+    ///
+    /// 结果和调用 frame_count 次 step(FrameInput{}) 完全一样，但是在什么都不会发生的时候，
+    /// 会直接跳到下一个计划帧到期的那一帧，而不是一帧一帧地空转。
+    /// @param frame_count 要推进的帧数
+    void step_idle(size_t frame_count);
+
+private:
+    /// 没有输入的时候，到下一个计划帧到期之前，step() 是否除了自增 logical_frame_count 之外什么都不做。
+    [[nodiscard]] bool is_idle_() const;
+};
+
+/// 一局游戏完整的模拟状态，由 GameData::save() 取出、GameData::restore() 放回。
+///
+/// 只含决定以后会发生什么的状态，影子、列高这些能从场地算出来的不存。可以平凡复制，
+/// 存一份、放回去都只是几百字节的 memcpy，回滚的时候可以每帧都存。各成员的含义和 GameData 中的同名成员一样。
+class GameSnapshot {
+public:
+    block current_block;
+    RotationState current_block_rotation_state;
+    BlockType current_block_type;
+    BlockType hold_block_type;
+    bool can_exchange_hold;
+    bool on_land;
+    bool topped_out;
+    PieceQueue next_queue;
+    decltype(GameData::matrix) matrix;
+    decltype(GameData::matrix_color) matrix_color;
+    size_t logical_frame_count;
+    PieceRng rng;
+    PieceRng garbage_rng;
+    ScheduledFrameStamp scheduled_frame_stamp_lock;
+    ScheduledFrameStamp scheduled_frame_stamp_down;
+    ScheduledFrameStamp scheduled_frame_stamp_move;
+    int32_t state_move_left;
+    int32_t state_move_right;
+    point<int32_t> move_offset;
+    size_t clear_line_count;
+    size_t piece_count;
+    uint32_t incoming_garbage;
+    uint32_t outgoing_attack;
+    size_t attack_line_count;
+    /// 可以从 matrix 算出来，但是重新算要逐格进行，存下来放回去更快
+    uint64_t matrix_hash;
+    ScoreState score_state;
+    ScoreEvent last_score_event;
+    int32_t last_rotation_kick;
+    SpinType locked_spin;
+    bool lock_pending;
+};
+
+static_assert(std::is_trivially_copyable_v<GameSnapshot>);
+
+
+#endif // GAME_DATA_H
@@ -1,30 +1,60 @@
 #include "keyboard.h"
 
 #include <algorithm>
-#include <ranges>
+#include <spdlog/spdlog.h>
 
 void Keyboard::update_event(const sf::Event &event) {
+    KeyEvent key_event{};
     if (const auto *key_pressed = event.getIf<sf::Event::KeyPressed>()) {
-        // releasing -> pressed
-        if (!key_state_.contains(key_pressed->scancode) || key_state_[key_pressed->scancode] == KeyState::Releasing) {
-            key_state_[key_pressed->scancode] = KeyState::Pressed;
-        }
+        key_event = {key_pressed->scancode, true};
     } else if (const auto *key_released = event.getIf<sf::Event::KeyReleased>()) {
-        // pressed / pressing -> releasing
-        key_state_[key_released->scancode] = KeyState::Releasing;
+        key_event = {key_released->scancode, false};
+    } else {
+        return;
+    }
+    if (key_event.scancode == sf::Keyboard::Scancode::Unknown) {
+        return;
+    }
+
+    if (!events_.try_push(key_event)) {
+        spdlog::warn("Keyboard event queue is full, dropping an event");
     }
 }
 
 void Keyboard::update() {
-    // pressed (上一次更新) -> pressing
-    std::ranges::for_each(key_state_ | std::views::filter([](const auto &p) { return p.second == KeyState::Pressed; }),
-                          [](auto &p) { p.second = KeyState::Pressing; });
+    // pressed (上一帧) -> pressing
+    std::ranges::replace(key_state_, KeyState::Pressed, KeyState::Pressing);
+    tapped_.fill(false);
+
+    // 一帧最多取 event_capacity 个，剩下的留到下一帧
+    for (size_t count = 0; count < event_capacity; count++) {
+        const auto key_event = events_.try_pop();
+        if (!key_event) {
+            break;
+        }
+
+        const auto key = static_cast<size_t>(key_event->scancode);
+        if (key_event->pressed) {
+            // releasing -> pressed。按住时系统发来的重复按下不算
+            if (key_state_[key] == KeyState::Releasing) {
+                key_state_[key] = KeyState::Pressed;
+            }
+        } else {
+            // pressed / pressing -> releasing。如果是这一帧才按下的，就记下来，免得这次按键被整个漏掉
+            if (key_state_[key] == KeyState::Pressed) {
+                tapped_[key] = true;
+            }
+            key_state_[key] = KeyState::Releasing;
+        }
+    }
 }
 
-bool Keyboard::is_key_pressed(const sf::Keyboard::Scancode scancode) {
-    return key_state_[scancode] == KeyState::Pressed;
+bool Keyboard::is_key_pressed(const sf::Keyboard::Scancode scancode) const {
+    const auto key = static_cast<size_t>(scancode);
+    return key_state_[key] == KeyState::Pressed || tapped_[key];
 }
 
-bool Keyboard::is_key_pressing(const sf::Keyboard::Scancode scancode) {
-    return key_state_[scancode] == KeyState::Pressed || key_state_[scancode] == KeyState::Pressing;
+bool Keyboard::is_key_pressing(const sf::Keyboard::Scancode scancode) const {
+    const auto key = static_cast<size_t>(scancode);
+    return key_state_[key] != KeyState::Releasing || tapped_[key];
 }
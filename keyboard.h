@@ -3,40 +3,64 @@
 
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Keyboard.hpp>
-#include <map>
+#include <array>
+
+#include "spsc_queue.h"
 
 
 /// 键盘状态
-enum class KeyState {
+enum class KeyState : uint8_t {
     Releasing = 0,
     /// 这个也归入到 is_key_pressing，仅因为要区分是否是刚刚按下才设定这两个状态。
     Pressed = 1,
     Pressing = 2,
 };
 
-/// 键盘
+/// 一次按键事件。
+class KeyEvent {
+public:
+    /// 按下或松开的键
+    sf::Keyboard::Scancode scancode;
+    /// 是按下还是松开
+    bool pressed;
+};
+
+/// 键盘。
+///
+/// 渲染线程收到事件之后调用 update_event() 放进一个无锁的单生产者单消费者队列，
+/// 逻辑线程每一帧调用 update() 按顺序把队列里的事件取出来，再查询按键状态。两边都不需要加锁。
+/// 除了 update_event() 之外的所有函数都只能在逻辑线程上调用。
 class Keyboard {
-    /// 键盘状态的 map
-    std::map<sf::Keyboard::Scancode, KeyState> key_state_;
+    /// 按键的个数
+    static constexpr size_t key_count = sf::Keyboard::ScancodeCount;
+    /// 一帧之内最多能缓冲的事件数
+    static constexpr size_t event_capacity = 256;
+
+    /// 渲染线程到逻辑线程的事件队列
+    SpscQueue<KeyEvent, event_capacity> events_;
+    /// 键盘状态，以 key_state_[scancode] 的方式访问
+    std::array<KeyState, key_count> key_state_{};
+    /// 在这一帧之内按下又松开了的键。这样的键在这一帧里也算刚被按下
+    std::array<bool, key_count> tapped_{};
 
 public:
     Keyboard() = default;
     ~Keyboard() = default;
 
-    /// 根据传入的事件更新键盘状态。
+    /// 渲染线程：把传入的按键事件放进队列，不是按键事件的话什么都不做。
     /// @param event 传入的事件
     void update_event(const sf::Event &event);
-    /// 更新键盘状态。
+    /// 逻辑线程：开始新的一帧。上一帧刚按下的键变成按住，然后按顺序处理队列里所有的事件。
     void update();
 
     /// 测试一个键是否刚被按下。
     /// @param scancode 要测试的键
     /// @return 键是否刚按下
-    [[nodiscard]] bool is_key_pressed(sf::Keyboard::Scancode scancode);
+    [[nodiscard]] bool is_key_pressed(sf::Keyboard::Scancode scancode) const;
     /// 测试一个键是否被按下。
     /// @param scancode 要测试的键
     /// @return 键是否被按下
-    [[nodiscard]] bool is_key_pressing(sf::Keyboard::Scancode scancode);
+    [[nodiscard]] bool is_key_pressing(sf::Keyboard::Scancode scancode) const;
 };
 
 #endif // KEYBOARD_H
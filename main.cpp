@@ -1,14 +1,340 @@
 /// Zeetris 2: 一个由现代 C++ 构建、完全现代的俄罗斯方块 第二代。
 
 #include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <optional>
 #include <print>
+#include <span>
+#include <spdlog/cfg/env.h>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
 
+#include "batch_runner.h"
 #include "game.h"
+#include "perft.h"
+#include "profiler.h"
+#include "replay.h"
+#include "tick_log.h"
 
-int main() {
-    spdlog::set_level(spdlog::level::debug);
+/// 回放模式：不开窗口，以 CPU 能跑到的最快速度把录像重新跑一遍。
+/// @param path 录像文件的路径
+void play_replay(const char *path) {
+    spdlog::info("Loading replay {}...", path);
+    const auto replay = Replay::load(path);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto game_data = replay.play();
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto seconds = std::chrono::duration<double>(end - start).count();
+    const auto frames = game_data.logical_frame_count;
+    spdlog::info("Replayed {} frames in {:.3f} s ({:.0f}x real time), {} lines cleared", frames, seconds,
+                 static_cast<double>(frames) / 60. / seconds, game_data.clear_line_count);
+}
+
+/// 批量模式：在所有核心上无头地跑许多局，最后汇总统计。
+/// @param game_count 机器人玩的局数，replay_directory 不为空时忽略
+/// @param replay_directory 不为空时回放这个目录下所有的 .zrp 录像，而不是让机器人玩
+/// @param config 设置
+/// @param csv_path 不为空时把每一局的结果写成 CSV
+/// @return 机器人是否每一块都按计划放下了
+bool run_batch(const size_t game_count, const std::optional<std::string_view> replay_directory,
+               const BatchConfig &config, const std::optional<std::string_view> csv_path) {
+    BatchRunner batch_runner{config};
+
+    std::vector<std::filesystem::path> replay_paths;
+    if (replay_directory) {
+        for (const auto &entry: std::filesystem::directory_iterator{*replay_directory}) {
+            if (entry.is_regular_file() && entry.path().extension() == ".zrp") {
+                replay_paths.push_back(entry.path());
+            }
+        }
+        std::ranges::sort(replay_paths);
+    }
+    const auto total = replay_directory ? replay_paths.size() : game_count;
+    spdlog::info("Running {} games...", total);
+
+    // 每一局里的日志（比如每次消行）太多了，批量模式下只留警告
+    const auto level = spdlog::get_level();
+    spdlog::set_level(std::max(level, spdlog::level::warn));
+    const auto on_finished = [total](const size_t finished) {
+        if (finished * 10 / total != (finished - 1) * 10 / total) {
+            std::println(stderr, "{}/{} games finished", finished, total);
+        }
+    };
+    const auto summary = replay_directory ? batch_runner.run_replays(replay_paths, on_finished)
+                                          : batch_runner.run_bot_games(game_count, on_finished);
+    spdlog::set_level(level);
+
+    summary.log();
+    if (csv_path) {
+        summary.write_csv(*csv_path);
+        spdlog::info("Per-game results have been written to {}", *csv_path);
+    }
+    return std::ranges::all_of(summary.games, [](const GameStats &game) { return game.failed_path_count == 0; });
+}
+
+/// 一个落点的描述，比如 "T R (3, 4) hold"。
+std::string describe(const Placement &placement) {
+    constexpr std::string_view block_names = "?IJLOSZT";
+    constexpr std::string_view rotation_names = "0R2L";
+    return std::format("{} {} ({}, {}){}", block_names[static_cast<size_t>(placement.block_type)],
+                       rotation_names[static_cast<size_t>(placement.rotation_state)], placement.anchor.y,
+                       placement.anchor.x, placement.use_hold ? " hold" : "");
+}
+
+/// perft 模式：数出从一个局面出发放 depth 块的所有落点序列，报告每秒数过的节点数。
+/// @param position 起始局面
+/// @param depth 深度
+/// @param thread_count 线程数，大于 1 时按根的落点拆开并行地数
+/// @param divide 是否列出从根的每个落点展开的个数
+/// @param verify 是否再用 GameData 的操作逐个位置地数一遍，和移动生成器的结果比较
+/// @return 是否通过了比较，不比较时总是 true
+bool run_perft(const PerftPosition &position, const size_t depth, const size_t thread_count, const bool divide,
+               const bool verify) {
+    std::optional<ThreadPool> thread_pool;
+    if (thread_count > 1) {
+        thread_pool.emplace(thread_count);
+    }
+    auto *const pool = thread_pool ? &*thread_pool : nullptr;
+
+    spdlog::info("Perft to depth {} with {} pieces on {} threads...", depth, position.pieces.size(),
+                 std::max<size_t>(thread_count, 1));
+    const auto result = Perft::run(position, depth, Perft::Generator::Fast, pool);
+    if (divide) {
+        for (size_t idx = 0; idx < result.root_placements.size(); idx++) {
+            std::println("{}: {}", describe(result.root_placements[idx]), result.root_nodes[idx]);
+        }
+    }
+    spdlog::info("Nodes: {}, {:.3f} s, {:.0f} nodes/s", result.nodes,
+                 std::chrono::duration<double>(result.duration).count(), result.nodes_per_second());
+    if (!verify) {
+        return true;
+    }
+
+    spdlog::info("Verifying against the reference generator...");
+    const auto reference = Perft::run(position, depth, Perft::Generator::Reference, pool);
+    spdlog::info("Reference nodes: {}, {:.3f} s, {:.0f} nodes/s", reference.nodes,
+                 std::chrono::duration<double>(reference.duration).count(), reference.nodes_per_second());
+    // 根的落点是按格子排好序的，第一个对不上的就是要找的。格子一样、旋转状态不一样的落点算同一个
+    const auto cells_of = [](const Placement &placement) {
+        auto points = placement.to_block().points;
+        std::ranges::sort(points, {}, [](const point<int32_t> &point) { return std::pair{point.y, point.x}; });
+        return points;
+    };
+    const auto root_count = std::min(result.root_placements.size(), reference.root_placements.size());
+    for (size_t idx = 0; idx < root_count; idx++) {
+        if (cells_of(result.root_placements[idx]) != cells_of(reference.root_placements[idx]) ||
+            result.root_nodes[idx] != reference.root_nodes[idx]) {
+            spdlog::error("Mismatch at root placement {}: {} has {} nodes, reference {} has {}", idx,
+                          describe(result.root_placements[idx]), result.root_nodes[idx],
+                          describe(reference.root_placements[idx]), reference.root_nodes[idx]);
+            return false;
+        }
+    }
+    if (result.root_placements.size() != reference.root_placements.size()) {
+        spdlog::error("Mismatch in root placement count: {}, reference {}", result.root_placements.size(),
+                      reference.root_placements.size());
+        return false;
+    }
+    spdlog::info("Perft matches the reference generator");
+    return true;
+}
+
+/// 解析一个非负整数参数。
+/// @exception std::runtime_error 不是非负整数的时候，抛出这个 exception。
+template<typename T>
+T parse_number(const std::string_view text) {
+    T value{};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || end != text.data() + text.size()) {
+        throw std::runtime_error(std::format("Invalid number: {}", text));
+    }
+    return value;
+}
+
+/// 把剖析结果写进日志，并导出 Chrome trace。
+/// @param path 导出的路径，为空时只写日志
+void dump_profile(const std::optional<std::string_view> path) {
+#ifdef ZEETRIS_PROFILING
+    Profiler::instance().log_summary();
+    if (path) {
+        Profiler::instance().write_chrome_trace(*path);
+        spdlog::info("Chrome trace has been written to {}", *path);
+    }
+#else
+    if (path) {
+        spdlog::warn("Built without ZEETRIS_PROFILING, nothing to write to {}; "
+                     "reconfigure with -DZEETRIS_PROFILING=ON to enable the profiler",
+                     *path);
+    }
+#endif
+}
+
+int main(const int argc, char *argv[]) {
+    // 默认是 info，要看 debug 日志就设置环境变量 SPDLOG_LEVEL=debug。
+    // 逻辑帧里的 debug 日志还要在编译时把 ZEETRIS_TICK_LOG_LEVEL 调低才有
+    spdlog::cfg::load_env_levels();
     spdlog::info("Hello Zeetris 2!");
+
+    // --replay <path>：回放录像；--bot：让机器人来玩；--profile <path>：退出时导出 Chrome trace
+    // --batch <N>：无头地让机器人玩 N 局；--batch-replays <dir>：无头地回放目录下所有的录像。批量模式还可以加上
+    // --seed <S>（第一局的种子）、--pieces <M>（每局最多的块数）、--beam <W>（集束宽度）、--csv <path>（每局的结果）、
+    // --level <L>（开局的等级）、--think-frames <F>（每块先让重力走 F 帧再放下，有没放对的块时退出码是 1）
+    // --versus-host <port>：在 port 上等对手连上来对战；--versus-join <host:port>：连到对手那里对战
+    // --spectate <port>：在 port 上开观战服务器，把这一局直播给连上来的观战者
+    // --perft <depth>：数出放 depth 块的所有落点序列。还可以加上 --perft-board <path>（场地，默认是空的）、
+    // --perft-queue <pieces>（方块序列，比如 TIOLJSZ，默认是 --seed 开局的序列）、--perft-hold <piece>（暂存块）、
+    // --perft-divide（列出根的每个落点）、--perft-verify（和逐个位置的 BFS 比较）、--threads <N>（按根拆开并行）
+    const std::span args{argv, static_cast<size_t>(argc)};
+    std::optional<std::string_view> replay_path;
+    std::optional<std::string_view> profile_path;
+    auto use_bot = false;
+    std::optional<size_t> batch_count;
+    std::optional<std::string_view> batch_replay_directory;
+    std::optional<std::string_view> csv_path;
+    std::optional<VersusEndpoint> versus_endpoint;
+    std::optional<uint16_t> spectator_port;
+    std::optional<size_t> perft_depth;
+    PerftPosition perft_position;
+    auto perft_divide = false;
+    auto perft_verify = false;
+    size_t thread_count = 1;
+    BatchConfig batch_config;
+    try {
+        for (size_t idx = 1; idx < args.size(); idx++) {
+            const std::string_view arg{args[idx]};
+            const auto has_value = idx + 1 < args.size();
+            if (arg == "--bot") {
+                use_bot = true;
+            } else if (arg == "--replay" && has_value) {
+                replay_path = args[++idx];
+            } else if (arg == "--profile" && has_value) {
+                profile_path = args[++idx];
+            } else if (arg == "--batch" && has_value) {
+                batch_count = parse_number<size_t>(args[++idx]);
+            } else if (arg == "--batch-replays" && has_value) {
+                batch_replay_directory = args[++idx];
+            } else if (arg == "--seed" && has_value) {
+                batch_config.first_seed = parse_number<uint64_t>(args[++idx]);
+            } else if (arg == "--pieces" && has_value) {
+                batch_config.max_pieces = parse_number<size_t>(args[++idx]);
+            } else if (arg == "--level" && has_value) {
+                batch_config.start_level = parse_number<uint32_t>(args[++idx]);
+            } else if (arg == "--think-frames" && has_value) {
+                batch_config.think_frames = parse_number<size_t>(args[++idx]);
+            } else if (arg == "--beam" && has_value) {
+                batch_config.bot_config.beam_width = std::max<size_t>(parse_number<size_t>(args[++idx]), 1);
+            } else if (arg == "--csv" && has_value) {
+                csv_path = args[++idx];
+            } else if (arg == "--versus-host" && has_value) {
+                versus_endpoint = VersusEndpoint{"", parse_number<uint16_t>(args[++idx])};
+            } else if (arg == "--spectate" && has_value) {
+                spectator_port = parse_number<uint16_t>(args[++idx]);
+            } else if (arg == "--perft" && has_value) {
+                perft_depth = parse_number<size_t>(args[++idx]);
+            } else if (arg == "--perft-board" && has_value) {
+                perft_position.matrix = PerftPosition::load_board(args[++idx]);
+            } else if (arg == "--perft-queue" && has_value) {
+                perft_position.pieces = PerftPosition::parse_pieces(args[++idx]);
+            } else if (arg == "--perft-hold" && has_value) {
+                const auto pieces = PerftPosition::parse_pieces(args[++idx]);
+                if (pieces.size() != 1) {
+                    throw std::runtime_error("--perft-hold expects exactly one piece");
+                }
+                perft_position.hold_block_type = pieces.front();
+            } else if (arg == "--perft-divide") {
+                perft_divide = true;
+            } else if (arg == "--perft-verify") {
+                perft_verify = true;
+            } else if (arg == "--threads" && has_value) {
+                thread_count = std::max<size_t>(parse_number<size_t>(args[++idx]), 1);
+            } else if (arg == "--versus-join" && has_value) {
+                const std::string_view address{args[++idx]};
+                const auto colon = address.rfind(':');
+                if (colon == std::string_view::npos || colon == 0) {
+                    throw std::runtime_error(std::format("Expected <host:port>, got: {}", address));
+                }
+                versus_endpoint = VersusEndpoint{std::string{address.substr(0, colon)},
+                                                 parse_number<uint16_t>(address.substr(colon + 1))};
+            } else {
+                throw std::runtime_error(std::format("Unknown argument: {}", arg));
+            }
+        }
+        if (versus_endpoint && use_bot) {
+            // 机器人直接改 GameData，不经过输入，对手那边的镜像就对不上了
+            throw std::runtime_error("--bot cannot be used in versus mode");
+        }
+    } catch (const std::exception &exception) {
+        std::println(stderr, "{}", exception.what());
+        return 1;
+    }
+
+    // 逻辑帧里的日志由后台线程格式化、写出
+    TickLog::instance().start();
+
+    if (perft_depth) {
+        auto exit_code = 0;
+        try {
+            if (perft_position.pieces.empty()) {
+                // 和 --seed 开局时一样的方块序列，比深度多一块，交换暂存块的分支也能放满
+                GameData game_data{batch_config.first_seed};
+                game_data.start();
+                perft_position.pieces.push_back(game_data.current_block_type);
+                while (perft_position.pieces.size() <= *perft_depth) {
+                    if (game_data.next_queue.empty()) {
+                        game_data.new_bag();
+                    }
+                    perft_position.pieces.push_back(game_data.next_queue.front());
+                    game_data.next_queue.pop_front();
+                }
+            }
+            if (!run_perft(perft_position, *perft_depth, thread_count, perft_divide, perft_verify)) {
+                exit_code = 1;
+            }
+        } catch (const std::exception &exception) {
+            std::println(stderr, "Exception occurred:\n{}", exception.what());
+            exit_code = 1;
+        }
+        TickLog::instance().stop();
+        return exit_code;
+    }
+
+    if (batch_count || batch_replay_directory) {
+        auto exit_code = 0;
+        try {
+            if (!run_batch(batch_count.value_or(0), batch_replay_directory, batch_config, csv_path)) {
+                exit_code = 1;
+            }
+            dump_profile(profile_path);
+        } catch (const std::exception &exception) {
+            std::println(stderr, "Exception occurred:\n{}", exception.what());
+            exit_code = 1;
+        }
+        TickLog::instance().stop();
+        return exit_code;
+    }
+
+    if (replay_path) {
+        auto exit_code = 0;
+        try {
+            play_replay(replay_path->data());
+            dump_profile(profile_path);
+        } catch (const std::exception &exception) {
+            std::println(stderr, "Exception occurred:\n{}", exception.what());
+            exit_code = 1;
+        }
+        TickLog::instance().stop();
+        return exit_code;
+    }
+
     spdlog::info("Loading fonts...");
     sf::Font unifont;
     if (!unifont.openFromFile("assets/unifont-16.0.02.otf")) {
@@ -20,12 +346,14 @@ int main() {
     sf::RenderWindow render_window{sf::VideoMode{sf::Vector2u{1366, 768}}, L"Zeetris 2"};
     render_window.setFramerateLimit(120);
 
-    Game game{&render_window, font};
+    Game game{&render_window, font, use_bot, versus_endpoint, spectator_port};
     try {
         game.run();
+        dump_profile(profile_path);
     } catch (const std::exception &exception) {
         std::println(stderr, "Exception occurred:\n{}", exception.what());
     }
+    TickLog::instance().stop();
 
     return 0;
 }
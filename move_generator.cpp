@@ -0,0 +1,408 @@
+#include "move_generator.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+
+namespace {
+    /// 一个方块在某个旋转状态下按行拆开的形状。
+    class row_shape {
+    public:
+        /// 最低一行相对锚点的 y
+        int32_t min_dy;
+        /// 最左一列相对锚点的 x
+        int32_t min_dx;
+        /// 最右一列相对锚点的 x
+        int32_t max_dx;
+        /// 占据的行数
+        int32_t row_count;
+        /// 每一行的掩码，从最低一行开始，第 0 位对应最左一列
+        std::array<uint16_t, 4> rows;
+    };
+
+    /// 预设值，表示每种方块在每个旋转状态下按行拆开的形状，以 row_shapes[方块类型][旋转状态] 的方式访问。
+    constexpr auto row_shapes = [] {
+        std::array<std::array<row_shape, 4>, block_shapes.size()> result{};
+        for (size_t type = 0; type < block_shapes.size(); type++) {
+            for (size_t state = 0; state < 4; state++) {
+                const auto &block_shape = block_shapes[type][state];
+                auto &[min_dy, min_dx, max_dx, row_count, rows] = result[type][state];
+                min_dy = std::ranges::min(block_shape, {}, &point<int32_t>::y).y;
+                min_dx = std::ranges::min(block_shape, {}, &point<int32_t>::x).x;
+                max_dx = std::ranges::max(block_shape, {}, &point<int32_t>::x).x;
+                row_count = std::ranges::max(block_shape, {}, &point<int32_t>::y).y - min_dy + 1;
+                for (const auto &[y, x]: block_shape) {
+                    rows[y - min_dy] |= static_cast<uint16_t>(1u << (x - min_dx));
+                }
+            }
+        }
+        return result;
+    }();
+
+    /// 两个旋转方向，和 Move 中的旋转操作一一对应
+    constexpr std::array rotations{std::pair{RotationState::Left, Move::RotateLeft},
+                                   std::pair{RotationState::Right, Move::RotateRight}};
+
+    /// 旋转之后的旋转状态。
+    constexpr RotationState rotated(const RotationState rotation_state, const RotationState rotation) {
+        return static_cast<RotationState>((static_cast<int>(rotation_state) + static_cast<int>(rotation)) % 4);
+    }
+
+    /// 把一列的掩码整体上下移动，dy 为正表示向上。
+    constexpr uint32_t shift_y(const uint32_t mask, const int32_t dy) {
+        return dy >= 0 ? mask << dy : mask >> -dy;
+    }
+
+    /// 在一列中从 seeds 出发一直往下落，返回经过的所有 y。
+    ///
+    /// 这是 Kogge-Stone 式的填充：每一步让能走的距离翻倍，5 步就能走完 32 位。
+    constexpr uint32_t drop_fill(uint32_t seeds, uint32_t free) {
+        seeds |= free & (seeds >> 1);
+        free &= free >> 1;
+        seeds |= free & (seeds >> 2);
+        free &= free >> 2;
+        seeds |= free & (seeds >> 4);
+        free &= free >> 4;
+        seeds |= free & (seeds >> 8);
+        free &= free >> 8;
+        seeds |= free & (seeds >> 16);
+        return seeds;
+    }
+} // namespace
+
+uint16_t MoveGenerator::state_index(const RotationState rotation_state, const point<int32_t> anchor) {
+    return static_cast<uint16_t>(
+            (static_cast<size_t>(rotation_state) * anchor_x_count + static_cast<size_t>(anchor.x + anchor_x_offset)) *
+                    anchor_y_count +
+            static_cast<size_t>(anchor.y + anchor_y_offset));
+}
+
+bool MoveGenerator::fits(const matrix_type &matrix, const BlockType block_type, const RotationState rotation_state,
+                         const point<int32_t> anchor) {
+    const auto &[min_dy, min_dx, max_dx, row_count, rows] =
+            row_shapes[static_cast<size_t>(block_type)][static_cast<size_t>(rotation_state)];
+    const int32_t left = anchor.x + min_dx;
+    const int32_t bottom = anchor.y + min_dy;
+    if (left < 0 || anchor.x + max_dx >= static_cast<int32_t>(GameData::width) || bottom < 0 ||
+        bottom + row_count > static_cast<int32_t>(matrix.size())) {
+        return false;
+    }
+    for (int32_t row = 0; row < row_count; row++) {
+        if ((matrix[bottom + row] & (rows[row] << left)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t MoveGenerator::free_of_(const size_t column) {
+    if ((free_valid_ >> column & 1u) != 0) {
+        return free_[column];
+    }
+    free_valid_ |= uint64_t{1} << column;
+
+    const auto rotation_state = column / anchor_x_count;
+    const auto x = static_cast<int32_t>(column % anchor_x_count) - anchor_x_offset;
+    const auto &[min_dy, min_dx, max_dx, row_count, rows] =
+            row_shapes[static_cast<size_t>(block_type_)][rotation_state];
+    const int32_t left = x + min_dx;
+    uint32_t free = 0;
+    if (left >= 0 && x + max_dx < static_cast<int32_t>(GameData::width)) {
+        const auto &matrix = *matrix_;
+        const auto height = static_cast<int32_t>(matrix.size());
+        for (int32_t bottom = 0; bottom + row_count <= height; bottom++) {
+            bool fit = true;
+            for (int32_t row = 0; row < row_count && fit; row++) {
+                fit = (matrix[bottom + row] & (rows[row] << left)) == 0;
+            }
+            if (fit) {
+                free |= 1u << (bottom - min_dy + anchor_y_offset);
+            }
+        }
+    }
+    free_[column] = free;
+    return free;
+}
+
+bool MoveGenerator::insert_key_(const uint64_t key) {
+    // Fibonacci 哈希加线性探测。实际的落点只有一两百个，表很稀疏
+    for (size_t slot = (key * 0x9E3779B97F4A7C15ull) >> (64 - seen_bits);; slot = (slot + 1) % seen_keys_.size()) {
+        if (seen_generation_[slot] != generation_) {
+            seen_generation_[slot] = generation_;
+            seen_keys_[slot] = key;
+            return true;
+        }
+        if (seen_keys_[slot] == key) {
+            return false;
+        }
+    }
+}
+
+void MoveGenerator::search_(const matrix_type &matrix, const BlockType block_type,
+                            const RotationState rotation_state, const point<int32_t> anchor, const bool use_hold) {
+    roots_[use_hold] = {matrix, block_type, rotation_state, anchor};
+    if (!fits(matrix, block_type, rotation_state, anchor)) {
+        return;
+    }
+
+    block_type_ = block_type;
+    matrix_ = &matrix;
+    free_valid_ = 0;
+    reach_.fill(0);
+    rotation_reach_.fill(0);
+    triple_kick_reach_.fill(0);
+    const auto &kicks = kick_table[static_cast<size_t>(block_type)];
+
+    // 待处理的列，第 n 位为 1 表示第 n 列的 reach_ 有了新的 y
+    uint64_t pending = 0;
+    const auto add = [&](const size_t column, const uint32_t mask) {
+        if ((mask & ~reach_[column]) != 0) {
+            reach_[column] |= mask;
+            pending |= uint64_t{1} << column;
+        }
+    };
+
+    const auto root = static_cast<size_t>(rotation_state) * anchor_x_count + (anchor.x + anchor_x_offset);
+    add(root, 1u << (anchor.y + anchor_y_offset));
+
+    while (pending != 0) {
+        const auto column = static_cast<size_t>(std::countr_zero(pending));
+        pending &= pending - 1;
+
+        const auto free = free_of_(column);
+        // 软降
+        const auto reach = drop_fill(reach_[column], free);
+        reach_[column] = reach;
+
+        // 左右移动，要保证移动之后的 x 还在列的范围里
+        const auto x = column % anchor_x_count;
+        if (x > 0) {
+            add(column - 1, reach & free_of_(column - 1));
+        }
+        if (x + 1 < anchor_x_count) {
+            add(column + 1, reach & free_of_(column + 1));
+        }
+
+        // 旋转。每个 y 只用第一个能放下的踢墙偏移，所以要把已经踢成功的 y 去掉
+        const auto current_rotation_state = static_cast<RotationState>(column / anchor_x_count);
+        for (const auto &[rotation, move]: rotations) {
+            const auto new_rotation_state = rotated(current_rotation_state, rotation);
+            const auto &[count, offsets] =
+                    kicks[static_cast<size_t>(current_rotation_state)][static_cast<size_t>(new_rotation_state)];
+            uint32_t remaining = reach;
+            for (size_t idx = 0; idx < count && remaining != 0; idx++) {
+                const auto new_x = static_cast<int32_t>(x) + offsets[idx].x;
+                if (new_x < 0 || new_x >= static_cast<int32_t>(anchor_x_count)) {
+                    continue;
+                }
+                const auto new_column = static_cast<size_t>(new_rotation_state) * anchor_x_count + new_x;
+                const auto kicked = shift_y(remaining, offsets[idx].y) & free_of_(new_column);
+                remaining &= ~shift_y(kicked, -offsets[idx].y);
+                add(new_column, kicked);
+                rotation_reach_[new_column] |= kicked;
+                if (idx == GameData::triple_kick) {
+                    triple_kick_reach_[new_column] |= kicked;
+                }
+            }
+        }
+    }
+
+    // 落不下去的 y 就是落点。用最低行、最左列和每一行的掩码作为格子集合的键去重。
+    // 键里还要有 use_hold：暂存块为空、预览的第一个和当前方块同类时，交换之后格子一样，但用掉了一个预览块
+    for (size_t column = 0; column < column_count; column++) {
+        if (reach_[column] == 0) {
+            continue;
+        }
+        const auto current_rotation_state = static_cast<RotationState>(column / anchor_x_count);
+        const auto x = static_cast<int32_t>(column % anchor_x_count) - anchor_x_offset;
+        const auto &[min_dy, min_dx, max_dx, row_count, rows] =
+                row_shapes[static_cast<size_t>(block_type)][static_cast<size_t>(current_rotation_state)];
+        const uint64_t shape_key = static_cast<uint64_t>(x + min_dx) << 5 | static_cast<uint64_t>(rows[0]) << 9 |
+                                   static_cast<uint64_t>(rows[1]) << 13 | static_cast<uint64_t>(rows[2]) << 17 |
+                                   static_cast<uint64_t>(rows[3]) << 21 | static_cast<uint64_t>(use_hold) << 25;
+        for (auto landed = reach_[column] & ~(free_[column] << 1); landed != 0; landed &= landed - 1) {
+            const auto bit = std::countr_zero(landed);
+            const auto y = bit - anchor_y_offset;
+            if (insert_key_(shape_key | static_cast<uint64_t>(y + min_dy))) {
+                int8_t last_rotation_kick = -1;
+                if (triple_kick_reach_[column] >> bit & 1) {
+                    last_rotation_kick = GameData::triple_kick;
+                } else if (rotation_reach_[column] >> bit & 1) {
+                    last_rotation_kick = 0;
+                }
+                placements_.push_back({block_type, current_rotation_state, {y, x}, use_hold, last_rotation_kick});
+            }
+        }
+    }
+}
+
+void MoveGenerator::begin_generation_() {
+    placements_.clear();
+    if (++generation_ == 0) {
+        // 代数绕回来了，旧的标记会被误认为是这一代的，全部清掉
+        seen_generation_.fill(0);
+        generation_ = 1;
+    }
+}
+
+const std::vector<Placement> &MoveGenerator::generate(const GameData &game_data) {
+    begin_generation_();
+
+    if (game_data.current_block_type != BlockType::None) {
+        search_(game_data.matrix, game_data.current_block_type, game_data.current_block_rotation_state,
+                game_data.current_block.anchor, false);
+    }
+    if (game_data.can_exchange_hold) {
+        auto hold_block_type = game_data.hold_block_type;
+        if (hold_block_type == BlockType::None && !game_data.next_queue.empty()) {
+            hold_block_type = game_data.next_queue.front();
+        }
+        if (hold_block_type != BlockType::None) {
+            search_(game_data.matrix, hold_block_type, RotationState::Zero, GameData::spawn_anchor, true);
+        }
+    }
+    return placements_;
+}
+
+const std::vector<Placement> &MoveGenerator::generate(const matrix_type &matrix, const BlockType block_type,
+                                                     const BlockType hold_block_type) {
+    begin_generation_();
+    search_(matrix, block_type, RotationState::Zero, GameData::spawn_anchor, false);
+    if (hold_block_type != BlockType::None) {
+        search_(matrix, hold_block_type, RotationState::Zero, GameData::spawn_anchor, true);
+    }
+    return placements_;
+}
+
+std::vector<Move> MoveGenerator::path(const Placement &placement) const {
+    const auto &[matrix, block_type, rotation_state, anchor] = roots_[placement.use_hold];
+    const auto &kicks = kick_table[static_cast<size_t>(block_type)];
+    const auto root = state_index(rotation_state, anchor);
+    const auto target = state_index(placement.rotation_state, placement.anchor);
+
+    // 逐个位置的 BFS，找到目标（要以旋转结尾时，是找到转进目标的那一步）就停下
+    constexpr auto unvisited = UINT16_MAX;
+    std::vector<uint16_t> parent(state_count, unvisited);
+    std::vector<Move> parent_move(state_count);
+    std::vector<uint16_t> queue;
+    queue.reserve(state_count);
+
+    // 要以旋转结尾时，记下最先找到的、用合适的踢墙偏移转到目标的那个位置
+    uint16_t rotation_parent = unvisited;
+    Move rotation_move{};
+    const auto found = [&] {
+        return placement.last_rotation_kick < 0 ? parent[target] != unvisited : rotation_parent != unvisited;
+    };
+
+    parent[root] = root;
+    queue.push_back(root);
+    for (size_t head = 0; head < queue.size() && !found(); head++) {
+        const auto state = queue[head];
+        const auto current_rotation_state = static_cast<RotationState>(state / (anchor_x_count * anchor_y_count));
+        const auto y = static_cast<int32_t>(state % anchor_y_count) - anchor_y_offset;
+        const auto x = static_cast<int32_t>(state / anchor_y_count % anchor_x_count) - anchor_x_offset;
+
+        const auto visit = [&](const RotationState to_rotation_state, const point<int32_t> to_anchor,
+                               const Move move) {
+            if (!fits(matrix, block_type, to_rotation_state, to_anchor)) {
+                return false;
+            }
+            if (const auto to = state_index(to_rotation_state, to_anchor); parent[to] == unvisited) {
+                parent[to] = state;
+                parent_move[to] = move;
+                queue.push_back(to);
+            }
+            return true;
+        };
+
+        visit(current_rotation_state, {y, x - 1}, Move::Left);
+        visit(current_rotation_state, {y, x + 1}, Move::Right);
+        visit(current_rotation_state, {y - 1, x}, Move::SoftDrop);
+        for (const auto &[rotation, move]: rotations) {
+            const auto new_rotation_state = rotated(current_rotation_state, rotation);
+            const auto &[count, offsets] =
+                    kicks[static_cast<size_t>(current_rotation_state)][static_cast<size_t>(new_rotation_state)];
+            for (size_t idx = 0; idx < count; idx++) {
+                const point<int32_t> to_anchor{y + offsets[idx].y, x + offsets[idx].x};
+                if (!visit(new_rotation_state, to_anchor, move)) {
+                    continue;
+                }
+                if (rotation_parent == unvisited && state_index(new_rotation_state, to_anchor) == target &&
+                    (placement.last_rotation_kick != GameData::triple_kick ||
+                     idx == static_cast<size_t>(GameData::triple_kick))) {
+                    rotation_parent = state;
+                    rotation_move = move;
+                }
+                break;
+            }
+        }
+    }
+
+    std::vector<Move> result;
+    if (!found()) {
+        return result;
+    }
+    auto state = target;
+    if (placement.last_rotation_kick >= 0) {
+        result.push_back(rotation_move);
+        state = rotation_parent;
+    }
+    for (; state != root; state = parent[state]) {
+        result.push_back(parent_move[state]);
+    }
+    if (placement.use_hold) {
+        result.push_back(Move::Hold);
+    }
+    std::ranges::reverse(result);
+    return result;
+}
+
+bool perform(GameData &game_data, const std::vector<Move> &path) {
+    bool success = true;
+    for (const auto move: path) {
+        switch (move) {
+            case Move::Left:
+                success &= game_data.move(game_data.current_block, {0, -1});
+                break;
+            case Move::Right:
+                success &= game_data.move(game_data.current_block, {0, 1});
+                break;
+            case Move::RotateLeft:
+                success &= game_data.rotate(game_data.current_block, game_data.current_block_rotation_state,
+                                            game_data.current_block_type, RotationState::Left);
+                break;
+            case Move::RotateRight:
+                success &= game_data.rotate(game_data.current_block, game_data.current_block_rotation_state,
+                                            game_data.current_block_type, RotationState::Right);
+                break;
+            case Move::SoftDrop:
+                success &= game_data.move(game_data.current_block, {-1, 0});
+                break;
+            case Move::Hold:
+                success &= game_data.can_exchange_hold;
+                game_data.exchange_hold();
+                break;
+        }
+    }
+    game_data.hard_drop();
+    return success;
+}
+
+std::optional<std::vector<Move>> replan(MoveGenerator &move_generator, const GameData &game_data,
+                                        const Placement &placement) {
+    // 去重只保留占据相同格子的落点之一，旋转状态和锚点不一定和原来的一样，要比较格子
+    const auto sorted_points = [](const Placement &from) {
+        auto points = from.to_block().points;
+        std::ranges::sort(points, {}, [](const point<int32_t> &point) { return std::pair{point.y, point.x}; });
+        return points;
+    };
+    const auto target_points = sorted_points(placement);
+    for (const auto &candidate: move_generator.generate(game_data)) {
+        if (candidate.block_type == placement.block_type && candidate.use_hold == placement.use_hold &&
+            sorted_points(candidate) == target_points) {
+            return move_generator.path(candidate);
+        }
+    }
+    return std::nullopt;
+}
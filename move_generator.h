@@ -0,0 +1,180 @@
+#ifndef MOVE_GENERATOR_H
+#define MOVE_GENERATOR_H
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "game_data.h"
+
+
+/// 移动生成器中的一步操作。
+enum class Move : uint8_t {
+    Left = 0,
+    Right,
+    RotateLeft,
+    RotateRight,
+    SoftDrop,
+    /// 交换暂存块，只会出现在操作序列的开头
+    Hold,
+};
+
+/// 一个落点，即方块最终锁定时的位置。
+class Placement {
+public:
+    /// 方块类型
+    BlockType block_type;
+    /// 锁定时的旋转状态
+    RotationState rotation_state;
+    /// 锁定时的锚点
+    point<int32_t> anchor;
+    /// 是否先交换了暂存块
+    bool use_hold;
+    /// 最后一步能是旋转的话，旋转用的踢墙偏移的下标：能用第五个偏移转进来时是 GameData::triple_kick，否则记为 0。
+    /// 最后一步只能是移动或者软降时为 -1。MoveGenerator::path() 给出的操作序列以这样的旋转结尾，
+    /// 所以按它放下之后 GameData::detect_spin() 的判定，和直接用这个值判定的一样
+    int8_t last_rotation_kick = -1;
+
+    /// 锁定时的方块。
+    /// @return 锁定时的方块
+    [[nodiscard]] block to_block() const { return make_block(block_type, rotation_state, anchor); }
+};
+
+/// 移动生成器。
+///
+/// 从当前局面出发，搜出左右移动、软降和 rotate() 踢墙所能到达的所有落点，包括 Tuck 和 Spin。
+/// 占据的格子完全相同、是否交换了暂存块也相同的落点（比如 S、Z、I 的两个竖直方向）只保留一个。
+///
+/// 搜索按列并行：同一个旋转状态、同一个 x 的所有 y 压在一个 32 位掩码里，软降、移动和踢墙都是对整列做位运算，
+/// 而不是对每个位置单独检查碰撞。操作序列只在需要的时候用逐个位置的 BFS 还原。
+///
+/// 搜索用到的表都是复用的，不会在搜索时分配内存。一个 MoveGenerator 不是线程安全的，每个线程应该有自己的。
+class MoveGenerator {
+public:
+    /// 锚点的 x 的偏移，使得编号从 0 开始
+    static constexpr int32_t anchor_x_offset = 4;
+    /// 锚点的 y 的偏移，使得编号从 0 开始
+    static constexpr int32_t anchor_y_offset = 4;
+    /// 锚点的 x 的取值个数
+    static constexpr size_t anchor_x_count = 16;
+    /// 锚点的 y 的取值个数，正好是一个 uint32_t 的位数
+    static constexpr size_t anchor_y_count = 32;
+    /// 列的个数，一列是一个旋转状态下的一个 x
+    static constexpr size_t column_count = 4 * anchor_x_count;
+    /// 一个方块可能处于的状态总数
+    static constexpr size_t state_count = column_count * anchor_y_count;
+
+    /// 占用位图
+    using matrix_type = decltype(GameData::matrix);
+
+private:
+    /// 一次搜索的起点，还原操作序列时要用
+    class search_root {
+    public:
+        /// 占用位图
+        matrix_type matrix;
+        /// 方块类型
+        BlockType block_type;
+        /// 起点的旋转状态
+        RotationState rotation_state;
+        /// 起点的锚点
+        point<int32_t> anchor;
+    };
+
+    /// 当前正在搜索的方块类型
+    BlockType block_type_{BlockType::None};
+    /// 当前正在搜索的占用位图
+    const matrix_type *matrix_{nullptr};
+    /// 每一列中方块能放下的 y，第 y + anchor_y_offset 位为 1 表示能放下
+    std::array<uint32_t, column_count> free_{};
+    /// 每一列的 free_ 是否已经算过了
+    uint64_t free_valid_{};
+    /// 每一列中已经能到达的 y
+    std::array<uint32_t, column_count> reach_{};
+    /// 每一列中能由旋转直接到达的 y
+    std::array<uint32_t, column_count> rotation_reach_{};
+    /// 每一列中能由第五个踢墙偏移的旋转直接到达的 y
+    std::array<uint32_t, column_count> triple_kick_reach_{};
+    /// 落点去重的哈希表的大小的位数。两次搜索最多有 2 * state_count 个落点，表的大小取它的两倍，探测一定会停下来
+    static constexpr size_t seen_bits = 13;
+    static_assert((size_t{1} << seen_bits) >= 2 * 2 * state_count);
+    /// 落点去重的哈希表
+    std::array<uint64_t, size_t{1} << seen_bits> seen_keys_{};
+    /// 落点去重的哈希表中每一格的搜索代数，等于当前代数表示这一格是这次搜索写进去的，这样就不用每次都清空
+    std::array<uint32_t, size_t{1} << seen_bits> seen_generation_{};
+    /// 当前的搜索代数
+    uint32_t generation_{};
+    /// 两次搜索的起点，[0] 是当前方块的，[1] 是交换暂存块之后的
+    std::array<search_root, 2> roots_{};
+    /// 结果
+    std::vector<Placement> placements_{};
+
+    /// 开始新的一代搜索，清空上一次的结果。
+    void begin_generation_();
+
+    /// 一列中方块能放下的 y，第一次用到时才计算。
+    uint32_t free_of_(size_t column);
+
+    /// 从一个起点开始搜索，把搜到的落点追加到 placements_。
+    void search_(const matrix_type &matrix, BlockType block_type, RotationState rotation_state,
+                 point<int32_t> anchor, bool use_hold);
+
+    /// 落点去重。
+    /// @return 是否是第一次见到这个落点
+    bool insert_key_(uint64_t key);
+
+public:
+    MoveGenerator() = default;
+    ~MoveGenerator() = default;
+
+    /// 状态编号。
+    [[nodiscard]] static uint16_t state_index(RotationState rotation_state, point<int32_t> anchor);
+
+    /// 检查方块能否放在 matrix 中的某个位置，和 GameData::check() 等价，但是直接在占用位图上按行判断。
+    [[nodiscard]] static bool fits(const matrix_type &matrix, BlockType block_type, RotationState rotation_state,
+                                   point<int32_t> anchor);
+
+    /// 生成 game_data 当前局面下所有可以到达的落点。
+    ///
+    /// 当前方块从它现在的位置出发；如果还能交换暂存块，那么暂存块（暂存块为空时是预览序列的第一个）
+    /// 从出生位置出发，它的落点的 use_hold 为 true。
+    /// @param game_data 当前局面
+    /// @return 所有的落点。在下一次 generate() 之前一直有效。
+    const std::vector<Placement> &generate(const GameData &game_data);
+
+    /// 生成某种方块从出生位置出发，在 matrix 中所有可以到达的落点。
+    /// @param matrix 占用位图
+    /// @param block_type 方块类型
+    /// @param hold_block_type 交换暂存块之后得到的方块类型，不是 None 的话也会从出生位置搜它的落点
+    /// @return 所有的落点。在下一次 generate() 之前一直有效。
+    const std::vector<Placement> &generate(const matrix_type &matrix, BlockType block_type,
+                                           BlockType hold_block_type = BlockType::None);
+
+    /// 还原到达一个落点的最短操作序列。到达之后硬降即可锁定在这个落点。
+    ///
+    /// 落点的 last_rotation_kick 不是 -1 时，给出的是以这样的旋转结尾的最短操作序列，T-spin 不会因为
+    /// 最后一步走了别的路而丢掉。
+    /// @param placement 最近一次 generate() 返回的落点
+    /// @return 操作序列
+    [[nodiscard]] std::vector<Move> path(const Placement &placement) const;
+};
+
+/// 按操作序列操作 game_data 的当前方块，然后硬降。
+/// @param game_data 要操作的游戏数据
+/// @param path MoveGenerator::path() 给出的操作序列
+/// @return 是否每一步操作都成功了。不管成功与否，最后都会硬降。
+bool perform(GameData &game_data, const std::vector<Move> &path);
+
+/// 从 game_data 当前方块现在的位置重新规划到达一个落点的操作序列。
+///
+/// 规划之后、放下之前重力把方块往下拉了几格的话，原来的操作序列从新的位置走不通了，放下之前用它重新规划。
+/// @param move_generator 用来重新搜索的移动生成器，之前 generate() 的结果会失效
+/// @param game_data 当前局面
+/// @param placement 要到达的落点，按方块类型、是否交换暂存块和占据的格子比较
+/// @return 操作序列；从现在的位置已经到不了这个落点时返回 nullopt
+std::optional<std::vector<Move>> replan(MoveGenerator &move_generator, const GameData &game_data,
+                                        const Placement &placement);
+
+
+#endif // MOVE_GENERATOR_H
@@ -0,0 +1,327 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+namespace {
+    using matrix_type = MoveGenerator::matrix_type;
+
+    /// 落点树中的一个局面。
+    class perft_node {
+    public:
+        /// 占用位图
+        matrix_type matrix;
+        /// 接下来要放的方块，None 表示方块序列已经用完了
+        BlockType current_block_type;
+        /// 暂存块
+        BlockType hold_block_type;
+        /// 下一个要从方块序列里拿的方块的下标
+        size_t queue_position;
+    };
+
+    /// 消行。
+    void clear_lines(matrix_type &matrix) {
+        size_t count = 0;
+        for (size_t y = 0; y < matrix.size(); y++) {
+            if (matrix[y] == GameData::full_row) {
+                count++;
+            } else if (count != 0) {
+                matrix[y - count] = matrix[y];
+            }
+        }
+        std::fill(matrix.end() - static_cast<std::ptrdiff_t>(count), matrix.end(), uint16_t{0});
+    }
+
+    /// 方块所占的格子排好序之后拼起来，占据的格子完全相同的两个方块的键相同。
+    uint64_t cells_key(const block &block) {
+        std::array<uint64_t, 4> cells{};
+        std::ranges::transform(block.points, cells.begin(), [](const point<int32_t> &point) {
+            return static_cast<uint64_t>(point.y) << 4 | static_cast<uint64_t>(point.x);
+        });
+        std::ranges::sort(cells);
+        return cells[0] | cells[1] << 16 | cells[2] << 32 | cells[3] << 48;
+    }
+
+    /// 在 node 上放下一个落点，得到子局面。
+    perft_node apply(const perft_node &node, const Placement &placement, const std::span<const BlockType> pieces) {
+        perft_node child = node;
+        if (placement.use_hold) {
+            child.hold_block_type = node.current_block_type;
+            if (node.hold_block_type == BlockType::None) {
+                // 暂存块本来是空的，放下的是方块序列里的下一个
+                child.queue_position++;
+            }
+        }
+        for (const auto &[y, x]: placement.to_block().points) {
+            child.matrix[y] |= static_cast<uint16_t>(1u << x);
+        }
+        clear_lines(child.matrix);
+        child.current_block_type = BlockType::None;
+        if (child.queue_position < pieces.size()) {
+            child.current_block_type = pieces[child.queue_position++];
+        }
+        return child;
+    }
+
+    /// 逐个位置 BFS 的落点生成，碰撞、移动和旋转都直接用 GameData 的。
+    ///
+    /// 和 MoveGenerator 一样：落点是往下移动不了的位置，同一种方块的一次搜索里占据的格子完全相同的落点只保留一个。
+    /// 交换暂存块的落点和不交换的分开去重，格子一样也是不同的局面。
+    class reference_generator {
+        /// 只用到 matrix，用来做碰撞检测和踢墙
+        GameData scratch_{0};
+        /// 每个状态是否已经到达过，以 MoveGenerator::state_index() 为下标
+        std::vector<bool> visited_ = std::vector<bool>(MoveGenerator::state_count);
+        /// BFS 的队列
+        std::vector<std::pair<block, RotationState>> queue_;
+        /// 这一次搜索已经找到的落点所占的格子，用来去重
+        std::vector<uint64_t> seen_keys_;
+        /// 结果
+        std::vector<Placement> placements_;
+
+        /// 从出生位置开始搜索一种方块，把搜到的落点追加到 placements_。
+        void search_(const BlockType block_type, const bool use_hold) {
+            const auto spawn = make_block(block_type, RotationState::Zero, GameData::spawn_anchor);
+            if (!scratch_.check(spawn)) {
+                return;
+            }
+            visited_.assign(visited_.size(), false);
+            queue_.clear();
+            seen_keys_.clear();
+            const auto visit = [this](const block &block, const RotationState rotation_state) {
+                if (const auto index = MoveGenerator::state_index(rotation_state, block.anchor); !visited_[index]) {
+                    visited_[index] = true;
+                    queue_.emplace_back(block, rotation_state);
+                }
+            };
+
+            visit(spawn, RotationState::Zero);
+            for (size_t head = 0; head < queue_.size(); head++) {
+                // queue_ 会变长，不能拿引用
+                const auto [current, rotation_state] = queue_[head];
+                for (const auto offset: {point<int32_t>{0, -1}, point<int32_t>{0, 1}, point<int32_t>{-1, 0}}) {
+                    auto moved = current;
+                    if (scratch_.move(moved, offset, false)) {
+                        visit(moved, rotation_state);
+                    }
+                }
+                for (const auto rotation: {RotationState::Left, RotationState::Right}) {
+                    auto rotated = current;
+                    auto rotated_state = rotation_state;
+                    if (scratch_.rotate(rotated, rotated_state, block_type, rotation, false)) {
+                        visit(rotated, rotated_state);
+                    }
+                }
+
+                if (auto below = current; scratch_.move(below, {-1, 0}, false)) {
+                    continue;
+                }
+                // 落不下去了，是一个落点
+                if (const auto key = cells_key(current); std::ranges::find(seen_keys_, key) == seen_keys_.end()) {
+                    seen_keys_.push_back(key);
+                    placements_.push_back({block_type, rotation_state, current.anchor, use_hold});
+                }
+            }
+        }
+
+    public:
+        /// 和 MoveGenerator::generate() 一样。
+        const std::vector<Placement> &generate(const matrix_type &matrix, const BlockType block_type,
+                                               const BlockType hold_block_type) {
+            scratch_.matrix = matrix;
+            placements_.clear();
+            search_(block_type, false);
+            if (hold_block_type != BlockType::None) {
+                search_(hold_block_type, true);
+            }
+            return placements_;
+        }
+    };
+
+    /// 一个线程上的 perft。每一层的落点放在自己的缓冲区里，数的时候不会分配内存。
+    class perft_walker {
+        /// 方块序列
+        std::span<const BlockType> pieces_;
+        /// 每一层的落点由谁给出
+        Perft::Generator generator_;
+        /// 移动生成器，挺大的，放在堆上
+        std::unique_ptr<MoveGenerator> move_generator_;
+        /// 逐个位置 BFS 的落点生成
+        std::unique_ptr<reference_generator> reference_generator_;
+        /// 每一层的落点，以剩下的深度为下标
+        std::vector<std::vector<Placement>> layers_;
+
+    public:
+        perft_walker(const std::span<const BlockType> pieces, const Perft::Generator generator, const size_t depth) :
+            pieces_(pieces), generator_(generator), layers_(depth + 1) {
+            if (generator_ == Perft::Generator::Fast) {
+                move_generator_ = std::make_unique<MoveGenerator>();
+            } else {
+                reference_generator_ = std::make_unique<reference_generator>();
+            }
+        }
+
+        /// node 的所有落点。
+        /// @param node 局面
+        /// @param depth 剩下的深度，决定放在哪一层的缓冲区里
+        /// @return 落点，在下一次以同样的 depth 调用之前一直有效
+        const std::vector<Placement> &generate(const perft_node &node, const size_t depth) {
+            auto hold_block_type = node.hold_block_type;
+            if (hold_block_type == BlockType::None && node.queue_position < pieces_.size()) {
+                hold_block_type = pieces_[node.queue_position];
+            }
+            auto &layer = layers_[depth];
+            if (generator_ == Perft::Generator::Fast) {
+                layer = move_generator_->generate(node.matrix, node.current_block_type, hold_block_type);
+            } else {
+                layer = reference_generator_->generate(node.matrix, node.current_block_type, hold_block_type);
+            }
+            return layer;
+        }
+
+        /// 数从 node 出发、放 depth 块的落点序列。
+        /// @param node 局面
+        /// @param depth 深度，至少为 1
+        /// @return 落点序列的个数
+        uint64_t count(const perft_node &node, const size_t depth) {
+            if (node.current_block_type == BlockType::None) {
+                // 方块序列用完了
+                return 0;
+            }
+            const auto &placements = generate(node, depth);
+            if (depth == 1) {
+                // 最后一层只数个数，不用真的放下去
+                return placements.size();
+            }
+            uint64_t nodes = 0;
+            for (const auto &placement: placements) {
+                nodes += count(apply(node, placement, pieces_), depth - 1);
+            }
+            return nodes;
+        }
+    };
+} // namespace
+
+MoveGenerator::matrix_type PerftPosition::parse_board(const std::string_view text) {
+    std::vector<std::string_view> lines;
+    for (size_t begin = 0; begin < text.size();) {
+        auto end = text.find('\n', begin);
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+        auto line = text.substr(begin, end - begin);
+        if (line.ends_with('\r')) {
+            line.remove_suffix(1);
+        }
+        lines.push_back(line);
+        begin = end + 1;
+    }
+    // 文件末尾的空行不算
+    while (!lines.empty() && lines.back().find_first_not_of(' ') == std::string_view::npos) {
+        lines.pop_back();
+    }
+
+    MoveGenerator::matrix_type matrix{};
+    if (lines.size() > matrix.size()) {
+        throw std::runtime_error(std::format("Board has {} rows, at most {} are allowed.", lines.size(),
+                                             matrix.size()));
+    }
+    for (size_t idx = 0; idx < lines.size(); idx++) {
+        const auto line = lines[idx];
+        const auto y = lines.size() - 1 - idx;
+        if (line.size() > GameData::width) {
+            throw std::runtime_error(std::format("Board row {} has {} columns, at most {} are allowed.", y,
+                                                 line.size(), GameData::width));
+        }
+        for (size_t x = 0; x < line.size(); x++) {
+            if (line[x] != '.' && line[x] != ' ') {
+                matrix[y] |= static_cast<uint16_t>(1u << x);
+            }
+        }
+    }
+    return matrix;
+}
+
+MoveGenerator::matrix_type PerftPosition::load_board(const std::filesystem::path &path) {
+    std::ifstream stream{path};
+    if (!stream) {
+        throw std::runtime_error(std::format("Failed to open {} for reading.", path.string()));
+    }
+    const std::string text{std::istreambuf_iterator<char>{stream}, std::istreambuf_iterator<char>{}};
+    return parse_board(text);
+}
+
+std::vector<BlockType> PerftPosition::parse_pieces(const std::string_view text) {
+    constexpr std::string_view names = "IJLOSZT";
+    std::vector<BlockType> pieces;
+    for (const auto character: text) {
+        const auto upper = static_cast<char>(character >= 'a' && character <= 'z' ? character - 'a' + 'A' : character);
+        const auto idx = names.find(upper);
+        if (idx == std::string_view::npos) {
+            throw std::runtime_error(std::format("Unknown piece '{}' in {}.", character, text));
+        }
+        // BlockType 里 None 之后就是 I、J、L、O、S、Z、T
+        pieces.push_back(static_cast<BlockType>(idx + 1));
+    }
+    return pieces;
+}
+
+double PerftResult::nodes_per_second() const {
+    const auto seconds = std::chrono::duration<double>(duration).count();
+    return seconds > 0. ? static_cast<double>(nodes) / seconds : 0.;
+}
+
+PerftResult Perft::run(const PerftPosition &position, const size_t depth, const Generator generator,
+                       ThreadPool *thread_pool) {
+    const std::span<const BlockType> pieces = position.pieces;
+    if (pieces.size() < depth) {
+        throw std::runtime_error(std::format("Perft to depth {} needs at least {} pieces, got {}.", depth, depth,
+                                             pieces.size()));
+    }
+
+    PerftResult result;
+    const auto start = std::chrono::steady_clock::now();
+    if (depth == 0) {
+        result.nodes = 1;
+        result.duration = std::chrono::steady_clock::now() - start;
+        return result;
+    }
+
+    const perft_node root{position.matrix, pieces.front(), position.hold_block_type, 1};
+    perft_walker root_walker{pieces, generator, depth};
+    result.root_placements = root_walker.generate(root, depth);
+    // 两种生成器给出落点的顺序不一样，占据同样格子的落点留下的旋转状态也可能不一样，按格子排好序才能逐个比较
+    std::ranges::sort(result.root_placements, {}, [](const Placement &placement) {
+        return std::pair{placement.use_hold, cells_key(placement.to_block())};
+    });
+    result.root_nodes.assign(result.root_placements.size(), 1);
+    if (depth > 1) {
+        const auto &root_placements = result.root_placements;
+        if (thread_pool != nullptr) {
+            // 从根的每个落点展开的子树互不相干，一个落点一个任务，每个任务有自己的移动生成器和缓冲区
+            thread_pool->parallel_for(root_placements.size(), [&](const size_t idx) {
+                perft_walker walker{pieces, generator, depth - 1};
+                result.root_nodes[idx] = walker.count(apply(root, root_placements[idx], pieces), depth - 1);
+            });
+        } else {
+            for (size_t idx = 0; idx < root_placements.size(); idx++) {
+                result.root_nodes[idx] = root_walker.count(apply(root, root_placements[idx], pieces), depth - 1);
+            }
+        }
+    }
+    for (const auto nodes: result.root_nodes) {
+        result.nodes += nodes;
+    }
+    result.duration = std::chrono::steady_clock::now() - start;
+    return result;
+}
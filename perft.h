@@ -0,0 +1,85 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "move_generator.h"
+#include "thread_pool.h"
+
+
+/// perft 的起始局面：一个场地和一串固定的方块。
+class PerftPosition {
+public:
+    /// 占用位图
+    MoveGenerator::matrix_type matrix{};
+    /// 方块序列，pieces[0] 是当前方块，后面的是预览序列
+    std::vector<BlockType> pieces;
+    /// 暂存块
+    BlockType hold_block_type = BlockType::None;
+
+    /// 解析场地。每一行是场地的一行，最上面的一行在最前面、最后一行是 y = 0；'.' 和空格是空的，别的字符都算占用。
+    /// @param text 场地的文本
+    /// @exception std::runtime_error 行数或者列数超出了场地的时候，抛出这个 exception。
+    static MoveGenerator::matrix_type parse_board(std::string_view text);
+
+    /// 从文件读取场地，格式和 parse_board() 一样。
+    /// @param path 文件路径
+    /// @exception std::runtime_error 文件打不开，或者格式不对的时候，抛出这个 exception。
+    static MoveGenerator::matrix_type load_board(const std::filesystem::path &path);
+
+    /// 解析方块序列，比如 "TIOLJSZ"，大小写都可以。
+    /// @param text 方块序列的文本
+    /// @exception std::runtime_error 有不是方块的字符的时候，抛出这个 exception。
+    static std::vector<BlockType> parse_pieces(std::string_view text);
+};
+
+/// 一次 perft 的结果。
+class PerftResult {
+public:
+    /// 叶子的个数，即深度为 depth 的落点序列的个数
+    uint64_t nodes{};
+    /// 根的每个落点，按是否交换了暂存块和所占的格子排好序，两种生成器的结果可以逐个比较
+    std::vector<Placement> root_placements;
+    /// 从根的每个落点展开的叶子个数，和 root_placements 一一对应（国际象棋 perft 的 divide）
+    std::vector<uint64_t> root_nodes;
+    /// 用的时间
+    std::chrono::nanoseconds duration{};
+
+    /// 每秒数过的叶子个数。
+    [[nodiscard]] double nodes_per_second() const;
+};
+
+/// 落点树的 perft：从一个局面出发，数出放 depth 块一共有多少种不同的落点序列。
+///
+/// 和国际象棋引擎用 perft 检验走法生成一样：每一层的落点由移动生成器给出（左右移动、软降、rotate() 踢墙，
+/// 以及交换暂存块），锁定、消行之后展开下一层；最后一层只数个数，不再展开。同样的局面和深度的结果是固定的，
+/// 优化了移动生成器之后数出来的数不变，就说明踢墙表和碰撞检测没有被改坏。
+///
+/// 暂存块为空时交换暂存块会多用掉预览序列里的一块，方块序列用完了的分支不会再展开。
+class Perft {
+public:
+    /// 每一层的落点由谁给出。
+    enum class Generator {
+        /// MoveGenerator，按列并行的位运算搜索
+        Fast,
+        /// 直接用 GameData::move() 和 GameData::rotate() 逐个位置 BFS，慢，但是和游戏里的操作完全一样
+        Reference,
+    };
+
+    /// 数落点序列。
+    /// @param position 起始局面
+    /// @param depth 深度，即放几块
+    /// @param generator 每一层的落点由谁给出
+    /// @param thread_pool 不为空时根的每个落点是一个任务，在这个线程池上并行地数
+    /// @return 结果
+    /// @exception std::runtime_error 方块序列比 depth 短的时候，抛出这个 exception。
+    static PerftResult run(const PerftPosition &position, size_t depth, Generator generator = Generator::Fast,
+                           ThreadPool *thread_pool = nullptr);
+};
+
+
+#endif // PERFT_H
@@ -0,0 +1,65 @@
+#ifndef PIECE_QUEUE_H
+#define PIECE_QUEUE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+
+enum class BlockType : int8_t;
+
+/// 预览序列。容量固定的环形队列，元素直接存在对象里，不会分配内存，复制它就是复制几十个字节。
+class PieceQueue {
+public:
+    /// 容量。游戏中最多同时有两个包（14 个），这里留足余量
+    static constexpr size_t capacity = 32;
+
+private:
+    std::array<BlockType, capacity> pieces_{};
+    /// 队首的下标
+    uint8_t head_{};
+    /// 元素个数
+    uint8_t size_{};
+
+public:
+    [[nodiscard]] size_t size() const { return size_; }
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+
+    /// 第 idx 个元素，0 是队首。
+    [[nodiscard]] BlockType operator[](const size_t idx) const { return pieces_[(head_ + idx) % capacity]; }
+
+    /// 队首。
+    [[nodiscard]] BlockType front() const { return (*this)[0]; }
+
+    /// 放到队尾。
+    /// @exception std::runtime_error 队列满了的时候，抛出这个 exception。
+    void push_back(const BlockType block_type) {
+        if (size_ == capacity) {
+            throw std::runtime_error("PieceQueue is full.");
+        }
+        pieces_[(head_ + size_) % capacity] = block_type;
+        size_++;
+    }
+
+    /// 去掉队首。
+    void pop_front() {
+        head_ = static_cast<uint8_t>((head_ + 1) % capacity);
+        size_--;
+    }
+
+    bool operator==(const PieceQueue &queue) const {
+        if (size_ != queue.size_) {
+            return false;
+        }
+        for (size_t idx = 0; idx < size_; idx++) {
+            if ((*this)[idx] != queue[idx]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+#endif // PIECE_QUEUE_H
@@ -0,0 +1,146 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <fstream>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+
+namespace {
+    /// 导出 JSON 时转义字符串。
+    std::string escape_json(const std::string_view text) {
+        std::string escaped;
+        for (const auto character: text) {
+            if (character == '"' || character == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(character);
+        }
+        return escaped;
+    }
+} // namespace
+
+thread_local Profiler::thread_ring *Profiler::current_ring_ = nullptr;
+
+Profiler &Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::thread_ring &Profiler::local_ring_() {
+    if (current_ring_ == nullptr) {
+        auto ring = std::make_unique<thread_ring>();
+        std::lock_guard guard(mutex_);
+        ring->thread_id = static_cast<uint32_t>(rings_.size());
+        current_ring_ = ring.get();
+        rings_.push_back(std::move(ring));
+    }
+    return *current_ring_;
+}
+
+void Profiler::record(const char *name, const clock::time_point start, const clock::time_point end) {
+    auto &ring = local_ring_();
+    const auto head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % ring_capacity] = {name, (start - epoch_).count(), (end - start).count()};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::set_thread_name(std::string name) {
+    auto &ring = local_ring_();
+    std::lock_guard guard(mutex_);
+    ring.thread_name = std::move(name);
+}
+
+std::vector<PhaseSummary> Profiler::summarize() const {
+    std::map<std::string_view, std::vector<int64_t>> durations;
+    {
+        std::lock_guard guard(mutex_);
+        for (const auto &ring: rings_) {
+            const auto head = ring->head.load(std::memory_order_acquire);
+            for (auto idx = head - std::min(head, ring_capacity); idx < head; idx++) {
+                const auto &event = ring->events[idx % ring_capacity];
+                durations[event.name].push_back(event.duration);
+            }
+        }
+    }
+
+    std::vector<PhaseSummary> summaries;
+    for (auto &[name, values]: durations) {
+        std::ranges::sort(values);
+        PhaseSummary summary{std::string{name}, values.size()};
+        const auto percentile = [&values](const size_t percent) {
+            return values[(values.size() - 1) * percent / 100];
+        };
+        summary.min = values.front();
+        summary.max = values.back();
+        summary.p50 = percentile(50);
+        summary.p90 = percentile(90);
+        summary.p99 = percentile(99);
+        for (const auto value: values) {
+            summary.total += value;
+            const auto bucket =
+                    static_cast<size_t>(std::bit_width(static_cast<uint64_t>(std::max<int64_t>(value, 0))));
+            summary.histogram[std::min(bucket, summary.histogram.size() - 1)]++;
+        }
+        summaries.push_back(std::move(summary));
+    }
+    std::ranges::sort(summaries, std::ranges::greater{}, &PhaseSummary::total);
+    return summaries;
+}
+
+void Profiler::log_summary() const {
+    const auto microseconds = [](const int64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1000.; };
+    for (const auto &summary: summarize()) {
+        spdlog::info("{:<24} n={:<8} total={:>10.1f} us  mean={:>8.2f} us  p50={:>8.2f} us  p90={:>8.2f} us  "
+                     "p99={:>8.2f} us  max={:>8.2f} us",
+                     summary.name, summary.count, microseconds(summary.total),
+                     microseconds(summary.total) / static_cast<double>(summary.count), microseconds(summary.p50),
+                     microseconds(summary.p90), microseconds(summary.p99), microseconds(summary.max));
+
+        // 直方图只打印非空的桶，桶的上界按 2 的幂写成 ns
+        std::string histogram;
+        for (size_t bucket = 0; bucket < summary.histogram.size(); bucket++) {
+            if (summary.histogram[bucket] != 0) {
+                histogram += std::format(" <{}ns:{}", uint64_t{1} << bucket, summary.histogram[bucket]);
+            }
+        }
+        spdlog::info("{:<24}{}", "", histogram);
+    }
+}
+
+void Profiler::write_chrome_trace(const std::filesystem::path &path) const {
+    std::ofstream stream{path};
+    if (!stream) {
+        throw std::runtime_error(std::format("Failed to open {} for writing.", path.string()));
+    }
+
+    std::lock_guard guard(mutex_);
+    stream << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    bool first = true;
+    const auto separator = [&first, &stream] {
+        if (!first) {
+            stream << ",\n";
+        }
+        first = false;
+    };
+    for (const auto &ring: rings_) {
+        if (!ring->thread_name.empty()) {
+            separator();
+            stream << std::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})",
+                                  ring->thread_id, escape_json(ring->thread_name));
+        }
+        const auto head = ring->head.load(std::memory_order_acquire);
+        for (auto idx = head - std::min(head, ring_capacity); idx < head; idx++) {
+            const auto &[name, start, duration] = ring->events[idx % ring_capacity];
+            separator();
+            // trace_event 的时间单位是 us
+            stream << std::format(R"({{"name":"{}","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                                  escape_json(name), ring->thread_id, static_cast<double>(start) / 1000.,
+                                  static_cast<double>(duration) / 1000.);
+        }
+    }
+    stream << "]}\n";
+}
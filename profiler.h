@@ -0,0 +1,133 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+/// 一段被计时的区间。
+class ProfileEvent {
+public:
+    /// 阶段名。必须是字符串字面量之类的、一直有效的字符串
+    const char *name;
+    /// 开始时间，相对于 Profiler 创建的时间 (ns)
+    int64_t start;
+    /// 持续时间 (ns)
+    int64_t duration;
+};
+
+/// 一个阶段的统计。
+class PhaseSummary {
+public:
+    /// 阶段名
+    std::string name;
+    /// 次数
+    size_t count{};
+    /// 总时间、最短、最长和分位数 (ns)
+    int64_t total{}, min{}, max{}, p50{}, p90{}, p99{};
+    /// 直方图，histogram[k] 是持续时间在 [2^(k-1), 2^k) ns 之间的次数
+    std::array<size_t, 40> histogram{};
+};
+
+/// 分阶段的帧剖析器。
+///
+/// 每个线程第一次记录时会分配一个自己的环形缓冲区，之后的记录只有这个线程自己写，不加锁、不分配内存；
+/// 缓冲区满了就覆盖最旧的记录。导出时把所有线程的记录汇总成 Chrome 的 trace_event JSON（可以在 chrome://tracing
+/// 或者 Perfetto 里打开），或者按阶段统计出分位数和直方图。
+///
+/// 导出的时候记录的线程应当已经停下来了（比如逻辑线程已经 join 了），否则正在被覆盖的那几条记录可能是半新半旧的。
+class Profiler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// 每个线程的环形缓冲区能放下的记录数
+    static constexpr size_t ring_capacity = 1 << 15;
+
+private:
+    /// 一个线程的环形缓冲区
+    class thread_ring {
+    public:
+        std::array<ProfileEvent, ring_capacity> events{};
+        /// 一共写过多少条记录，只由所属线程写
+        std::atomic_size_t head{};
+        /// 线程编号，导出时用
+        uint32_t thread_id{};
+        /// 线程名，导出时用。受 Profiler::mutex_ 保护
+        std::string thread_name;
+    };
+
+    /// 当前线程的缓冲区，第一次记录之前是空的
+    static thread_local thread_ring *current_ring_;
+
+    /// 计时的零点
+    clock::time_point epoch_{clock::now()};
+    /// 所有线程的缓冲区。线程退出之后也保留着，导出时还要用
+    std::vector<std::unique_ptr<thread_ring>> rings_;
+    /// 只在注册新线程、改线程名和导出时加锁
+    mutable std::mutex mutex_;
+
+    Profiler() = default;
+
+    /// 当前线程的缓冲区，第一次调用时注册。
+    thread_ring &local_ring_();
+
+public:
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    /// 全局唯一的剖析器。
+    static Profiler &instance();
+
+    /// 记录一段区间。
+    /// @param name 阶段名，必须一直有效
+    /// @param start 开始时间
+    /// @param end 结束时间
+    void record(const char *name, clock::time_point start, clock::time_point end);
+
+    /// 给当前线程起个名字，导出时显示。
+    void set_thread_name(std::string name);
+
+    /// 按阶段统计，按总时间从多到少排序。
+    [[nodiscard]] std::vector<PhaseSummary> summarize() const;
+
+    /// 把统计结果写进日志。
+    void log_summary() const;
+
+    /// 导出 Chrome trace_event 格式的 JSON。
+    /// @param path 文件路径
+    /// @exception std::runtime_error 文件打不开的时候，抛出这个 exception。
+    void write_chrome_trace(const std::filesystem::path &path) const;
+};
+
+/// 作用域计时器，析构时把这段区间记录到 Profiler。
+class ProfileScope {
+    const char *name_;
+    Profiler::clock::time_point start_;
+
+public:
+    explicit ProfileScope(const char *name) : name_(name), start_(Profiler::clock::now()) {}
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+    ~ProfileScope() { Profiler::instance().record(name_, start_, Profiler::clock::now()); }
+};
+
+#define ZEETRIS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define ZEETRIS_PROFILE_CONCAT(a, b) ZEETRIS_PROFILE_CONCAT_IMPL(a, b)
+
+/// 给当前作用域计时。关掉 ZEETRIS_PROFILING 之后什么都不做。
+#ifdef ZEETRIS_PROFILING
+#define ZEETRIS_PROFILE_SCOPE(name) const ProfileScope ZEETRIS_PROFILE_CONCAT(profile_scope_, __LINE__){name}
+#else
+#define ZEETRIS_PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
+
+
+#endif // PROFILER_H
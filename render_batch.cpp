@@ -0,0 +1,141 @@
+#include "render_batch.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+
+GlyphAtlas::GlyphAtlas(const sf::Font &font, const unsigned int character_size) :
+    font_(&font), character_size_(character_size) {
+    // 先把要用的字形都取一遍，字体会把它们排进自己的纹理里，之后这张纹理就不会再变了
+    for (char character = first_char; character <= last_char; character++) {
+        glyphs_[static_cast<size_t>(character - first_char)] = font.getGlyph(character, character_size, false);
+    }
+
+    // 在字体的纹理下面补一块 4x4 的白色，纹理坐标取它的中心，平滑采样也不会采到旁边的字形
+    constexpr unsigned int tile_size = 4;
+    const sf::Image glyph_image = font.getTexture(character_size).copyToImage();
+    sf::Image image{{std::max(glyph_image.getSize().x, tile_size), glyph_image.getSize().y + tile_size},
+                    sf::Color::Transparent};
+    if (!image.copy(glyph_image, {0, 0})) {
+        throw std::runtime_error("Failed to copy the glyphs into the atlas.");
+    }
+    for (unsigned int y = 0; y < tile_size; y++) {
+        for (unsigned int x = 0; x < tile_size; x++) {
+            image.setPixel({x, glyph_image.getSize().y + y}, sf::Color::White);
+        }
+    }
+    if (!texture_.loadFromImage(image)) {
+        throw std::runtime_error("Failed to create the glyph atlas texture.");
+    }
+    texture_.setSmooth(font.isSmooth());
+    white_texel_ = {static_cast<float>(tile_size) / 2.f,
+                    static_cast<float>(glyph_image.getSize().y) + static_cast<float>(tile_size) / 2.f};
+}
+
+const sf::Glyph &GlyphAtlas::glyph(const char character) const {
+    if (character < first_char || character > last_char) {
+        return glyphs_['?' - first_char];
+    }
+    return glyphs_[static_cast<size_t>(character - first_char)];
+}
+
+float GlyphAtlas::kerning(const char first, const char second) const {
+    return font_->getKerning(first, second, character_size_);
+}
+
+RenderBatch::RenderBatch(const size_t vertex_count) : vertices_(vertex_count) {
+    use_vertex_buffer_ = sf::VertexBuffer::isAvailable() && vertex_buffer_.create(vertex_count);
+    if (use_vertex_buffer_) {
+        // 第一次 draw() 把整个数组传上去
+        dirty_ranges_.emplace_back(0, vertex_count);
+    } else {
+        spdlog::warn("sf::VertexBuffer is not available, falling back to client-side vertex arrays");
+    }
+}
+
+std::span<sf::Vertex> RenderBatch::region(const size_t offset, const size_t count) {
+    if (use_vertex_buffer_) {
+        if (!dirty_ranges_.empty() && dirty_ranges_.back().second >= offset &&
+            dirty_ranges_.back().first <= offset + count) {
+            auto &[begin, end] = dirty_ranges_.back();
+            begin = std::min(begin, offset);
+            end = std::max(end, offset + count);
+        } else {
+            dirty_ranges_.emplace_back(offset, offset + count);
+        }
+    }
+    return std::span{vertices_}.subspan(offset, count);
+}
+
+void RenderBatch::fill_texture_coords(const size_t offset, const size_t count, const sf::Vector2f texel) {
+    for (auto &vertex: region(offset, count)) {
+        vertex.texCoords = texel;
+    }
+}
+
+void RenderBatch::draw(sf::RenderTarget &target, const sf::Texture &texture) {
+    for (const auto &[begin, end]: dirty_ranges_) {
+        if (!vertex_buffer_.update(vertices_.data() + begin, end - begin, static_cast<unsigned int>(begin))) {
+            spdlog::warn("Failed to update sf::VertexBuffer, falling back to client-side vertex arrays");
+            use_vertex_buffer_ = false;
+            break;
+        }
+    }
+    dirty_ranges_.clear();
+
+    const sf::RenderStates states{&texture};
+    if (use_vertex_buffer_) {
+        target.draw(vertex_buffer_, states);
+    } else {
+        target.draw(vertices_.data(), vertices_.size(), sf::PrimitiveType::Triangles, states);
+    }
+}
+
+TextSlot::TextSlot(const size_t offset, const sf::Vector2f position) : offset_(offset), position_(position) {}
+
+void TextSlot::set(RenderBatch &batch, const GlyphAtlas &atlas, std::string_view text) {
+    text = text.substr(0, std::min(text.size(), max_length));
+    if (text == text_) {
+        return;
+    }
+    text_ = text;
+
+    // 和 sf::Text 的排法一样：基线在字号那么高的地方，字形四周各留 1 像素，相邻字符之间加上字距调整
+    constexpr float padding = 1.f;
+    const auto vertices = batch.region(offset_, std::max(text.size(), glyph_count_) * 6);
+    float x = position_.x;
+    const float y = position_.y + static_cast<float>(atlas.character_size());
+    for (size_t idx = 0; idx < text.size(); idx++) {
+        if (idx > 0) {
+            x += atlas.kerning(text[idx - 1], text[idx]);
+        }
+        const auto &glyph = atlas.glyph(text[idx]);
+        auto *quad = vertices.data() + idx * 6;
+        if (glyph.textureRect.size.x == 0 || glyph.textureRect.size.y == 0) {
+            // 空格之类的没有字形，只往前走
+            std::fill(quad, quad + 6, sf::Vertex{});
+            x += glyph.advance;
+            continue;
+        }
+        const auto left = x + glyph.bounds.position.x - padding;
+        const auto top = y + glyph.bounds.position.y - padding;
+        const auto right = x + glyph.bounds.position.x + glyph.bounds.size.x + padding;
+        const auto bottom = y + glyph.bounds.position.y + glyph.bounds.size.y + padding;
+        const auto u1 = static_cast<float>(glyph.textureRect.position.x) - padding;
+        const auto v1 = static_cast<float>(glyph.textureRect.position.y) - padding;
+        const auto u2 = static_cast<float>(glyph.textureRect.position.x + glyph.textureRect.size.x) + padding;
+        const auto v2 = static_cast<float>(glyph.textureRect.position.y + glyph.textureRect.size.y) + padding;
+
+        quad[0] = {{left, top}, sf::Color::White, {u1, v1}};
+        quad[1] = {{left, bottom}, sf::Color::White, {u1, v2}};
+        quad[2] = {{right, top}, sf::Color::White, {u2, v1}};
+        quad[3] = {{right, top}, sf::Color::White, {u2, v1}};
+        quad[4] = {{left, bottom}, sf::Color::White, {u1, v2}};
+        quad[5] = {{right, bottom}, sf::Color::White, {u2, v2}};
+        x += glyph.advance;
+    }
+    // 上一次更长的话，多出来的字符变回面积为零的三角形
+    std::ranges::fill(vertices.subspan(text.size() * 6), sf::Vertex{});
+    glyph_count_ = text.size();
+}
@@ -0,0 +1,134 @@
+#ifndef RENDER_BATCH_H
+#define RENDER_BATCH_H
+
+#include <SFML/Graphics.hpp>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+/// 字形和格子共用的纹理。
+///
+/// 字体里 ASCII 可打印字符的字形在构造时一次排好，再在下面补一块纯白的格子。场地、方块这些纯色的矩形
+/// 采样白色的那块，顶点颜色就是最后的颜色；文字采样字形，这样所有东西可以用同一张纹理、在一次 draw 里画完。
+class GlyphAtlas {
+public:
+    /// 第一个排进纹理的字符
+    static constexpr char first_char = ' ';
+    /// 最后一个排进纹理的字符。别的字符都画成 '?'
+    static constexpr char last_char = '~';
+
+private:
+    /// 字体，由 main 传过来，比这个对象活得久
+    const sf::Font *font_;
+    /// 字号
+    unsigned int character_size_;
+    /// 纹理
+    sf::Texture texture_;
+    /// 字形，以 glyphs_[字符 - first_char] 的方式访问
+    std::array<sf::Glyph, last_char - first_char + 1> glyphs_{};
+    /// 白色格子中心的纹理坐标
+    sf::Vector2f white_texel_{};
+
+public:
+    GlyphAtlas() = delete;
+
+    /// @param font 字体
+    /// @param character_size 字号
+    /// @exception std::runtime_error 纹理创建失败的时候，抛出这个 exception。
+    GlyphAtlas(const sf::Font &font, unsigned int character_size);
+
+    [[nodiscard]] const sf::Texture &texture() const { return texture_; }
+    [[nodiscard]] sf::Vector2f white_texel() const { return white_texel_; }
+    [[nodiscard]] unsigned int character_size() const { return character_size_; }
+    [[nodiscard]] float line_spacing() const { return font_->getLineSpacing(character_size_); }
+
+    /// 一个字符的字形，不在纹理里的字符返回 '?' 的字形。
+    [[nodiscard]] const sf::Glyph &glyph(char character) const;
+
+    /// 两个相邻字符之间的字距调整。
+    [[nodiscard]] float kerning(char first, char second) const;
+};
+
+/// 一帧里要画的所有东西，放在一个固定长度的三角形顶点数组里，用一次 draw 画完。
+///
+/// 每一部分（场地、方块、预览、每一行文字）在数组里占固定的一段，哪一段变了就用 region() 拿出来改，
+/// draw() 只把改过的段上传到显存。不支持 VertexBuffer 的时候退回到每帧从内存里画整个数组。
+/// 用不到的顶点保持默认值，都在原点，面积为零，画出来什么都没有。
+class RenderBatch {
+    /// 顶点
+    std::vector<sf::Vertex> vertices_;
+    /// 显存里的顶点
+    sf::VertexBuffer vertex_buffer_{sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Dynamic};
+    /// 是否在用 vertex_buffer_
+    bool use_vertex_buffer_;
+    /// 上一次 draw() 以来改过的段，[开始, 结束)，相邻的段合并在一起
+    std::vector<std::pair<size_t, size_t>> dirty_ranges_;
+
+public:
+    RenderBatch() = delete;
+
+    /// @param vertex_count 顶点个数，之后不会再变
+    explicit RenderBatch(size_t vertex_count);
+
+    /// 顶点个数。
+    [[nodiscard]] size_t size() const { return vertices_.size(); }
+
+    /// 拿出一段顶点来改，并把这一段标记为下一次 draw() 要上传的。
+    /// @param offset 这一段的第一个顶点的下标
+    /// @param count 顶点个数
+    std::span<sf::Vertex> region(size_t offset, size_t count);
+
+    /// 把一段的纹理坐标都设成同一个点，纯色的段在开始时调用一次。
+    /// @param offset 这一段的第一个顶点的下标
+    /// @param count 顶点个数
+    /// @param texel 纹理坐标
+    void fill_texture_coords(size_t offset, size_t count, sf::Vector2f texel);
+
+    /// 上传改过的段，然后用一次 draw 画出整个数组。
+    /// @param target 画在哪里
+    /// @param texture 纹理，见 GlyphAtlas
+    void draw(sf::RenderTarget &target, const sf::Texture &texture);
+};
+
+/// 批里的一行文字。
+///
+/// 在批里占 max_length 个字符的固定一段。字符串和上一次一样的时候什么都不做，变了才重新排字，
+/// 所以不变的文字每帧的开销只是一次字符串比较。超出 max_length 的部分不画。
+class TextSlot {
+public:
+    /// 一行最多的字符个数
+    static constexpr size_t max_length = 64;
+    /// 在批里占的顶点个数
+    static constexpr size_t vertex_count = max_length * 6;
+
+private:
+    /// 在批里的第一个顶点的下标
+    size_t offset_;
+    /// 左上角的坐标
+    sf::Vector2f position_;
+    /// 现在画着的字符串
+    std::string text_;
+    /// 现在画着的字符个数，更短的字符串要把多出来的顶点清掉
+    size_t glyph_count_{};
+
+public:
+    TextSlot() = delete;
+
+    /// @param offset 在批里的第一个顶点的下标
+    /// @param position 左上角的坐标
+    TextSlot(size_t offset, sf::Vector2f position);
+
+    /// 设置这一行的文字，变了才重新排字。
+    /// @param batch 批
+    /// @param atlas 字形
+    /// @param text 文字
+    void set(RenderBatch &batch, const GlyphAtlas &atlas, std::string_view text);
+};
+
+
+#endif // RENDER_BATCH_H
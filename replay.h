@@ -0,0 +1,59 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "game_data.h"
+
+
+/// 录像。记录开局的随机数种子和每个逻辑帧的输入，用来复现一局游戏。
+///
+/// 输入按游程编码存储：连续若干帧相同的输入（绝大多数是什么都没按的空闲帧）只存一次。
+class Replay {
+public:
+    /// 一段连续相同的输入。
+    class run {
+    public:
+        /// 这一段的输入
+        FrameInput input;
+        /// 这一段持续的帧数
+        uint32_t length;
+    };
+
+    /// 开局的随机数种子
+    uint64_t seed{};
+    /// 输入的游程
+    std::vector<run> runs{};
+
+    Replay() = default;
+    explicit Replay(const uint64_t seed) : seed(seed) {}
+    ~Replay() = default;
+
+    /// 在录像的末尾追加一帧的输入。
+    /// @param input 这一帧的输入
+    void record(const FrameInput &input);
+
+    /// 录像的总帧数。
+    /// @return 所有游程的长度之和
+    [[nodiscard]] size_t frame_count() const;
+
+    /// 保存录像到文件。
+    /// @param path 文件路径
+    /// @exception std::runtime_error 当文件无法写入的时候，抛出这个 exception。
+    void save(const std::filesystem::path &path) const;
+
+    /// 从文件读取录像。
+    /// @param path 文件路径
+    /// @return 读取到的录像
+    /// @exception std::runtime_error 当文件无法读取或者格式不对的时候，抛出这个 exception。
+    static Replay load(const std::filesystem::path &path);
+
+    /// 回放。用 seed 开一局新游戏，然后不限速地把每一帧的输入喂给 GameData::step()。
+    /// @return 回放结束时的游戏数据
+    [[nodiscard]] GameData play() const;
+};
+
+
+#endif // REPLAY_H
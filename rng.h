@@ -0,0 +1,89 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+
+/// SplitMix64。只用来把一个 64 位的种子展开成 xoshiro 的状态。
+class SplitMix64 {
+    uint64_t state_;
+
+public:
+    using result_type = uint64_t;
+
+    explicit constexpr SplitMix64(const uint64_t seed) : state_(seed) {}
+
+    constexpr result_type operator()() {
+        auto value = state_ += 0x9e3779b97f4a7c15;
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+        return value ^ (value >> 31);
+    }
+};
+
+/// xoshiro256**。状态只有 32 字节，复制一份（比如搜索的时候克隆局面）几乎不要钱，输出的序列在所有平台上都一样。
+///
+/// 满足 UniformRandomBitGenerator，也可以交给标准库的算法使用。
+class Xoshiro256StarStar {
+    std::array<uint64_t, 4> state_{};
+
+public:
+    using result_type = uint64_t;
+
+    /// @param seed 种子，相同的种子总是得到相同的序列
+    explicit constexpr Xoshiro256StarStar(const uint64_t seed) { this->seed(seed); }
+
+    /// 用新的种子重新开始。
+    /// @param seed 种子
+    constexpr void seed(const uint64_t seed) {
+        SplitMix64 split_mix{seed};
+        for (auto &word: state_) {
+            word = split_mix();
+        }
+    }
+
+    constexpr result_type operator()() {
+        const auto result = std::rotl(state_[1] * 5, 7) * 9;
+        const auto shifted = state_[1] << 17;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= shifted;
+        state_[3] = std::rotl(state_[3], 45);
+        return result;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    bool operator==(const Xoshiro256StarStar &rng) const = default;
+};
+
+/// 生成包用的随机数生成器。换成别的满足同样接口的生成器时只需要改这里
+using PieceRng = Xoshiro256StarStar;
+
+/// 在 [0, bound) 中均匀地取一个整数。
+///
+/// 用 Lemire 的乘法取高位加拒绝采样，没有偏差，也不依赖 std::uniform_int_distribution
+/// （它的实现因标准库而异，同一个种子在不同平台上会得到不同的包）。
+/// @param rng 随机数生成器，输出 64 位
+/// @param bound 上界，必须大于 0
+template<typename Rng>
+constexpr uint32_t uniform_below(Rng &rng, const uint32_t bound) {
+    auto product = static_cast<uint64_t>(static_cast<uint32_t>(rng() >> 32)) * bound;
+    if (auto low = static_cast<uint32_t>(product); low < bound) {
+        const auto threshold = static_cast<uint32_t>(-bound) % bound;
+        while (low < threshold) {
+            product = static_cast<uint64_t>(static_cast<uint32_t>(rng() >> 32)) * bound;
+            low = static_cast<uint32_t>(product);
+        }
+    }
+    return static_cast<uint32_t>(product >> 32);
+}
+
+
+#endif // RNG_H
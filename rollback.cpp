@@ -0,0 +1,35 @@
+#include "rollback.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+
+
+void RollbackPredictor::confirm(const GameData &confirmed, const FrameInput &input) {
+    confirmed_ = confirmed.save();
+    last_input_ = input;
+    stale_ = true;
+}
+
+const GameData *RollbackPredictor::predict(const size_t target_frame) {
+    if (!confirmed_) {
+        return nullptr;
+    }
+    const auto confirmed_frame = confirmed_->logical_frame_count;
+    const auto predicted_frame = confirmed_frame + std::min(target_frame - std::min(target_frame, confirmed_frame),
+                                                            max_frames);
+
+    ZEETRIS_PROFILE_SCOPE("rollback.predict");
+    if (stale_ || predicted_.logical_frame_count > predicted_frame) {
+        // 确认的局面变了：回滚到它，从头重新模拟
+        predicted_.restore(*confirmed_);
+        stale_ = false;
+    }
+    // 否则上一次预测出的那几帧还是对的，接着往前模拟就行。一直按着的键继续按着，没有新按下的键
+    FrameInput input{};
+    input.pressing = last_input_.pressing;
+    while (predicted_.logical_frame_count < predicted_frame && !predicted_.topped_out) {
+        predicted_.step(input);
+    }
+    return &predicted_;
+}
@@ -0,0 +1,46 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <cstddef>
+#include <optional>
+
+#include "game_data.h"
+
+
+/// 对手一局的预测，即 GGPO 式回滚网络同步中“回滚、重新模拟”的那一半。
+///
+/// 对手的输入要过一段网络延迟才到，按确认了的输入模拟出的镜像总是落后于自己。为了让画面上的对手和自己
+/// 在同一帧，从最后一个确认了的局面出发，假设对手一直按着最后确认的那些键、也没收到垃圾，往前模拟到
+/// 自己的帧数。真正的输入到了之后，预测错了的部分就随着下一次从新的确认局面重新模拟而被纠正。
+///
+/// 确认的局面变了之后，预测就是 restore() 一份快照，再 step() 最多 max_frames 帧，在一个逻辑帧里绰绰有余；
+/// 没变的话接着上一次的预测往前走。
+///
+/// 预测只用来显示，不会影响确认了的那一局，所以不会影响垃圾的交换。
+class RollbackPredictor {
+    /// 最后一个确认了的局面，还没有确认过时为空
+    std::optional<GameSnapshot> confirmed_;
+    /// 确认了的局面的最后一帧的输入
+    FrameInput last_input_{};
+    /// 确认了的局面变了之后还没有重新模拟
+    bool stale_{true};
+    /// 预测出的局面
+    GameData predicted_{0};
+
+public:
+    /// 最多往前预测的帧数。超过了就停在那里等对手，和 GGPO 的预测窗口一样
+    static constexpr size_t max_frames = 8;
+
+    /// 确认了一帧：记下确认了的局面。
+    /// @param confirmed 按对手真正的输入推进了一帧之后的局面
+    /// @param input 这一帧的输入
+    void confirm(const GameData &confirmed, const FrameInput &input);
+
+    /// 预测对手在 target_frame 时的局面。
+    /// @param target_frame 要预测到的帧，一般是自己的 logical_frame_count
+    /// @return 预测出的局面，还没有确认了的局面时返回 nullptr
+    const GameData *predict(size_t target_frame);
+};
+
+
+#endif // ROLLBACK_H
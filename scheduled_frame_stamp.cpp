@@ -1,6 +1,6 @@
 #include "scheduled_frame_stamp.h"
 
-#include <spdlog/spdlog.h>
+#include "tick_log.h"
 
 bool ScheduledFrameStamp::times_up_(const size_t &frame_stamp_count) const {
     return frame_stamp_count >= frame_stamp_ + duration_;
@@ -12,14 +12,14 @@ bool ScheduledFrameStamp::on_update(const size_t &frame_stamp_count) {
             break;
         case ScheduledState::Active:
             if (times_up_(frame_stamp_count)) {
-                spdlog::debug("Times up at frame {}", frame_stamp_count);
+                ZEETRIS_TICK_LOG_DEBUG("Times up at frame {}", frame_stamp_count);
                 state_ = ScheduledState::Inactive;
                 return true;
             }
             break;
         case ScheduledState::Loop:
             if (times_up_(frame_stamp_count)) {
-                spdlog::debug("Times up at frame {}, looping", frame_stamp_count);
+                ZEETRIS_TICK_LOG_DEBUG("Times up at frame {}, looping", frame_stamp_count);
                 frame_stamp_ = frame_stamp_count;
                 if (next_duration_.has_value()) {
                     duration_ = next_duration_.value();
@@ -40,3 +40,10 @@ void ScheduledFrameStamp::set_active(const size_t &frame_stamp_count) {
 bool ScheduledFrameStamp::is_active() const {
     return state_ == ScheduledState::Active || state_ == ScheduledState::Loop;
 }
+
+std::optional<size_t> ScheduledFrameStamp::next_frame() const {
+    if (!is_active()) {
+        return std::nullopt;
+    }
+    return frame_stamp_ + duration_;
+}
@@ -51,6 +51,10 @@ public:
     [[nodiscard]] bool on_update(const size_t &frame_stamp_count);
     void set_active(const size_t &frame_stamp_count);
     [[nodiscard]] bool is_active() const;
+
+    /// 下一次到期的帧，即 on_update() 下一次可能返回 true 的帧。
+    /// @return 不活动时返回 nullopt
+    [[nodiscard]] std::optional<size_t> next_frame() const;
 };
 
 #endif // SCHEDULED_FRAME_STAMP_H
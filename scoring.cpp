@@ -0,0 +1,58 @@
+#include "scoring.h"
+
+#include <algorithm>
+
+
+ScoreEvent ScoreState::lock(const LockResult &result, const uint32_t level) {
+    ScoreEvent event;
+    const auto lines = std::min<size_t>(result.lines, line_points.size() - 1);
+
+    uint64_t points;
+    uint32_t attack;
+    switch (result.spin) {
+        case SpinType::Mini:
+            points = mini_points[std::min(lines, mini_points.size() - 1)];
+            attack = mini_attack[std::min(lines, mini_attack.size() - 1)];
+            break;
+        case SpinType::Full:
+            points = spin_points[std::min(lines, spin_points.size() - 1)];
+            attack = spin_attack[std::min(lines, spin_attack.size() - 1)];
+            break;
+        default:
+            points = line_points[lines];
+            attack = line_attack[lines];
+            break;
+    }
+
+    if (lines == 0) {
+        // 没有消行：连击断了，B2B 不受影响（不消行的 T-spin 也不会断）
+        combo = -1;
+        score += points * level;
+        event.points = points * level;
+        return event;
+    }
+
+    // 四消和 T-spin 消行是“难的”，连着两次难的消行第二次有 B2B；中间夹着一次普通的消行就断了
+    const auto difficult = lines == 4 || result.spin != SpinType::None;
+    event.back_to_back = difficult && back_to_back;
+    back_to_back = difficult;
+    if (event.back_to_back) {
+        points = points * 3 / 2;
+        attack += back_to_back_attack;
+    }
+
+    combo++;
+    points += combo_points * static_cast<uint64_t>(combo);
+    attack += combo_attack[std::min<size_t>(static_cast<size_t>(combo), combo_attack.size() - 1)];
+
+    if (result.perfect_clear) {
+        points += event.back_to_back && lines == 4 ? back_to_back_perfect_clear_points : perfect_clear_points[lines];
+        attack += perfect_clear_attack;
+    }
+
+    event.points = points * level;
+    event.attack = attack;
+    event.combo = combo;
+    score += event.points;
+    return event;
+}
@@ -0,0 +1,99 @@
+#ifndef SCORING_H
+#define SCORING_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+/// T-spin 的种类。
+enum class SpinType : uint8_t {
+    None = 0,
+    /// T-spin Mini：三个角被占，但是 T 尖的那一边只占了一个，并且最后一次旋转不是用第五个踢墙偏移转进去的
+    Mini,
+    /// T-spin
+    Full,
+};
+
+/// 一次锁定的结果，计分需要知道的全部内容。
+class LockResult {
+public:
+    /// 消除的行数
+    uint32_t lines{};
+    /// 是否是 T-spin
+    SpinType spin{SpinType::None};
+    /// 消行之后场地是否全空了
+    bool perfect_clear{};
+};
+
+/// 一次锁定得到的东西。
+class ScoreEvent {
+public:
+    /// 分数
+    uint64_t points{};
+    /// 攻击行数（抵消之前）
+    uint32_t attack{};
+    /// 是否吃到了 B2B 的加成
+    bool back_to_back{};
+    /// 这次锁定之后的连击数，没有在连击时为 -1
+    int32_t combo{-1};
+};
+
+/// 准则计分：分数、B2B、连击、全消，以及由消除行数决定的等级。
+///
+/// 只是几次查表，机器人的搜索里每个落点都要算一次，不能比这更慢了。
+class ScoreState {
+public:
+    /// 单消、双消、三消、四消的分数，乘上等级
+    static constexpr std::array<uint64_t, 5> line_points{0, 100, 300, 500, 800};
+    /// T-spin Mini 消除 0、1、2 行的分数
+    static constexpr std::array<uint64_t, 3> mini_points{100, 200, 400};
+    /// T-spin 消除 0、1、2、3 行的分数
+    static constexpr std::array<uint64_t, 4> spin_points{400, 800, 1200, 1600};
+    /// 全消消除 1、2、3、4 行额外的分数，B2B 的四消全消是 back_to_back_perfect_clear_points
+    static constexpr std::array<uint64_t, 5> perfect_clear_points{0, 800, 1200, 1800, 2000};
+    /// B2B 的四消全消额外的分数
+    static constexpr uint64_t back_to_back_perfect_clear_points = 3200;
+    /// 每一连击的分数，乘上连击数和等级
+    static constexpr uint64_t combo_points = 50;
+
+    /// 单消、双消、三消、四消的攻击行数
+    static constexpr std::array<uint32_t, 5> line_attack{0, 0, 1, 2, 4};
+    /// T-spin Mini 消除 0、1、2 行的攻击行数
+    static constexpr std::array<uint32_t, 3> mini_attack{0, 0, 1};
+    /// T-spin 消除 0、1、2、3 行的攻击行数
+    static constexpr std::array<uint32_t, 4> spin_attack{0, 2, 4, 6};
+    /// 连击数对应的额外攻击行数，超过表的长度的按最后一个算
+    static constexpr std::array<uint32_t, 12> combo_attack{0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5};
+    /// B2B 额外的攻击行数
+    static constexpr uint32_t back_to_back_attack = 1;
+    /// 全消额外的攻击行数
+    static constexpr uint32_t perfect_clear_attack = 10;
+
+    /// 最高的等级
+    static constexpr uint32_t max_level = 15;
+    /// 每消除这么多行升一级
+    static constexpr size_t lines_per_level = 10;
+
+    /// 总分
+    uint64_t score{};
+    /// 连击数，即连续有消行的锁定次数减一，没有在连击时为 -1
+    int32_t combo{-1};
+    /// 上一次消行是否是“难的”（四消，或者 T-spin 消行），下一次难的消行可以吃到 B2B
+    bool back_to_back{};
+
+    /// 记一次锁定：更新连击和 B2B，加上分数。
+    /// @param result 这次锁定的结果
+    /// @param level 当前的等级
+    /// @return 这次锁定得到的分数和攻击
+    ScoreEvent lock(const LockResult &result, uint32_t level);
+
+    /// 消除了 clear_line_count 行时的等级，从 1 开始。
+    [[nodiscard]] static constexpr uint32_t level_of(const size_t clear_line_count) {
+        return static_cast<uint32_t>(std::min<size_t>(clear_line_count / lines_per_level + 1, max_level));
+    }
+};
+
+
+#endif // SCORING_H
@@ -0,0 +1,123 @@
+#include "spectator_server.h"
+
+#include <spdlog/spdlog.h>
+
+#include "profiler.h"
+
+
+void SpectatorServer::session::send(std::shared_ptr<const std::vector<std::byte>> message, const bool keyframe) {
+    if (closed_) {
+        return;
+    }
+    if (!synced_ && !keyframe) {
+        return;
+    }
+    if (keyframe) {
+        // 关键帧之前还没发出去的差量帧都没用了
+        drop_pending_();
+    } else if (outbox_.size() >= max_outbox_size) {
+        // 跟不上了：丢掉攒下的，等下一个关键帧重新开始
+        drop_pending_();
+        synced_ = false;
+        return;
+    }
+    synced_ = true;
+    outbox_.push_back(std::move(message));
+    if (!write_in_flight_) {
+        write_();
+    }
+}
+
+void SpectatorServer::session::drop_pending_() {
+    // 正在发的那一条不能动，它的缓冲区还被 async_write 引用着
+    outbox_.erase(outbox_.begin() + static_cast<std::ptrdiff_t>(write_in_flight_ ? 1 : 0), outbox_.end());
+}
+
+void SpectatorServer::session::write_() {
+    write_in_flight_ = true;
+    // 缓冲区由 outbox_ 里的 shared_ptr 持有，发完之前不会被放掉
+    boost::asio::async_write(socket_, boost::asio::buffer(*outbox_.front()),
+                             [self = shared_from_this()](const boost::system::error_code &error_code, size_t) {
+                                 self->write_in_flight_ = false;
+                                 if (error_code) {
+                                     if (error_code != boost::asio::error::operation_aborted) {
+                                         spdlog::info("Spectator disconnected: {}", error_code.message());
+                                     }
+                                     self->close();
+                                     return;
+                                 }
+                                 self->outbox_.pop_front();
+                                 if (!self->outbox_.empty()) {
+                                     self->write_();
+                                 }
+                             });
+}
+
+void SpectatorServer::session::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    drop_pending_();
+    boost::system::error_code error_code;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error_code);
+    socket_.close(error_code);
+}
+
+SpectatorServer::SpectatorServer(boost::asio::io_context &io_context, const uint16_t port,
+                                 const size_t keyframe_interval) :
+    acceptor_(io_context, boost::asio::ip::tcp::endpoint{boost::asio::ip::tcp::v4(), port}),
+    encoder_(keyframe_interval) {}
+
+void SpectatorServer::start() {
+    spdlog::info("Accepting spectators on port {}", acceptor_.local_endpoint().port());
+    accept_();
+}
+
+void SpectatorServer::accept_() {
+    acceptor_.async_accept([this](const boost::system::error_code &error_code, boost::asio::ip::tcp::socket socket) {
+        if (error_code) {
+            if (error_code != boost::asio::error::operation_aborted) {
+                spdlog::warn("Stopped accepting spectators: {}", error_code.message());
+            }
+            return;
+        }
+        boost::system::error_code option_error_code;
+        socket.set_option(boost::asio::ip::tcp::no_delay{true}, option_error_code);
+        spdlog::info("Spectator connected from {}", socket.remote_endpoint(option_error_code).address().to_string());
+        sessions_.push_back(std::make_shared<session>(std::move(socket)));
+        // 让它马上就能开始看
+        needs_keyframe_ = true;
+        accept_();
+    });
+}
+
+void SpectatorServer::broadcast(const GameData &game_data) {
+    std::erase_if(sessions_, [](const auto &session) { return session->closed(); });
+    if (sessions_.empty()) {
+        // 没人看就不编码，有人连上来的时候从关键帧开始
+        needs_keyframe_ = true;
+        return;
+    }
+
+    ZEETRIS_PROFILE_SCOPE("spectator.broadcast");
+    if (needs_keyframe_) {
+        encoder_.request_keyframe();
+        needs_keyframe_ = false;
+    }
+    auto message = std::make_shared<std::vector<std::byte>>();
+    const auto keyframe = encoder_.encode(game_data, *message) == SpectatorEncoder::MessageType::Keyframe;
+    const std::shared_ptr<const std::vector<std::byte>> shared_message = std::move(message);
+    for (const auto &session: sessions_) {
+        session->send(shared_message, keyframe);
+    }
+}
+
+void SpectatorServer::close() {
+    boost::system::error_code error_code;
+    acceptor_.close(error_code);
+    for (const auto &session: sessions_) {
+        session->close();
+    }
+    sessions_.clear();
+}
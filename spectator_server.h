@@ -0,0 +1,94 @@
+#ifndef SPECTATOR_SERVER_H
+#define SPECTATOR_SERVER_H
+
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "spectator_stream.h"
+
+
+/// 观战服务器：把一局游戏的观战流广播给任意多个连上来的观战者。
+///
+/// 每一帧只编码一次，编出来的消息放在一块 shared_ptr 持有的缓冲区里，所有观战者的 async_write
+/// 都直接引用这同一块，谁都不复制；最后一个发完的观战者放掉它。没有观战者的时候连编码都省了。
+///
+/// 新连上来的观战者从下一个关键帧开始收，服务器会让下一帧马上就是关键帧。跟不上的观战者（发件箱里
+/// 攒了太多条）会丢掉攒下的差量帧，等下一个关键帧重新开始，不会拖累别人，也不会无限地占用内存。
+///
+/// 和逻辑线程共用一个 io_context，不是线程安全的。
+class SpectatorServer {
+    /// 一个观战者。
+    class session : public std::enable_shared_from_this<session> {
+        boost::asio::ip::tcp::socket socket_;
+        /// 还没发出去的消息，队首的那一条可能正在发
+        std::deque<std::shared_ptr<const std::vector<std::byte>>> outbox_;
+        /// 是否有一个发送还没完成
+        bool write_in_flight_{false};
+        /// 是否已经收到过关键帧，没有的话差量帧对它没有意义
+        bool synced_{false};
+        /// 连接是否已经断开
+        bool closed_{false};
+
+        /// 丢掉还没开始发的消息。
+        void drop_pending_();
+
+        /// 发送队首的一条。
+        void write_();
+
+    public:
+        explicit session(boost::asio::ip::tcp::socket socket) : socket_(std::move(socket)) {}
+
+        /// 把一条消息放进发件箱。
+        /// @param message 消息，所有观战者共用
+        /// @param keyframe 是否是关键帧
+        void send(std::shared_ptr<const std::vector<std::byte>> message, bool keyframe);
+
+        /// 断开连接。
+        void close();
+
+        [[nodiscard]] bool closed() const { return closed_; }
+    };
+
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::list<std::shared_ptr<session>> sessions_;
+    SpectatorEncoder encoder_;
+    /// 是否有观战者在等关键帧
+    bool needs_keyframe_{false};
+
+    /// 接受下一个观战者。
+    void accept_();
+
+public:
+    /// 一个观战者的发件箱里最多攒多少条，超过了就丢掉，等下一个关键帧
+    static constexpr size_t max_outbox_size = 120;
+
+    /// @param io_context 逻辑线程的 io_context
+    /// @param port 监听的端口
+    /// @param keyframe_interval 两个关键帧之间最多的消息条数
+    /// @exception boost::system::system_error 端口监听不了的时候，抛出这个 exception。
+    SpectatorServer(boost::asio::io_context &io_context, uint16_t port,
+                    size_t keyframe_interval = SpectatorEncoder::default_keyframe_interval);
+    SpectatorServer(const SpectatorServer &) = delete;
+    SpectatorServer &operator=(const SpectatorServer &) = delete;
+
+    /// 开始接受观战者。
+    void start();
+
+    /// 把这一帧的局面广播给所有观战者。每个逻辑帧调用一次。
+    /// @param game_data 游戏数据
+    void broadcast(const GameData &game_data);
+
+    /// 不再接受观战者，断开所有的连接。挂着的操作都会被取消，io_context 就可以退出了。
+    void close();
+
+    /// 当前连着的观战者个数。
+    [[nodiscard]] size_t subscriber_count() const { return sessions_.size(); }
+};
+
+
+#endif // SPECTATOR_SERVER_H
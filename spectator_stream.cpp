@@ -0,0 +1,388 @@
+#include "spectator_stream.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "profiler.h"
+
+
+namespace {
+    /// 场地的行数
+    constexpr size_t matrix_height = GameData::height_main + GameData::height_buffer;
+    /// 每格颜色的位数
+    constexpr size_t color_bits = 4;
+    /// 锚点坐标编码时加上的偏移，让它变成非负数
+    constexpr int32_t anchor_bias = 8;
+    /// 锚点 y 的位数
+    constexpr size_t anchor_y_bits = 6;
+    /// 锚点 x 的位数
+    constexpr size_t anchor_x_bits = 5;
+    /// 每条消息前面的长度的字节数
+    constexpr size_t length_size = 2;
+
+    /// 逐位写入，先写低位。
+    class bit_writer {
+        std::vector<std::byte> *buffer_;
+        /// 已经写了多少位
+        size_t bit_count_{};
+        /// 开始写的位置，长度之后再填
+        size_t begin_;
+
+    public:
+        explicit bit_writer(std::vector<std::byte> &buffer) : buffer_(&buffer), begin_(buffer.size()) {
+            buffer_->resize(begin_ + length_size);
+        }
+
+        /// 写入 value 的低 bits 位。
+        void write(uint64_t value, const size_t bits) {
+            for (size_t written = 0; written < bits;) {
+                if (bit_count_ % 8 == 0) {
+                    buffer_->push_back(std::byte{0});
+                }
+                const auto offset = bit_count_ % 8;
+                const auto count = std::min(bits - written, 8 - offset);
+                const auto chunk = static_cast<uint8_t>(value & ((1u << count) - 1));
+                buffer_->back() |= static_cast<std::byte>(chunk << offset);
+                value >>= count;
+                written += count;
+                bit_count_ += count;
+            }
+        }
+
+        void write_bool(const bool value) { write(value ? 1 : 0, 1); }
+
+        /// 写入一个变长整数：每 4 位一组，组前一位表示后面还有没有。小的增量只要 5 位
+        void write_varint(uint64_t value) {
+            do {
+                write_bool(value >= 16);
+                write(value & 0xf, 4);
+                value >>= 4;
+            } while (value != 0);
+        }
+
+        /// 写完了，在开头填上长度。
+        void finish() const {
+            const auto size = buffer_->size() - begin_ - length_size;
+            if (size > UINT16_MAX) {
+                throw std::runtime_error("Spectator message is too long.");
+            }
+            (*buffer_)[begin_] = static_cast<std::byte>(size & 0xff);
+            (*buffer_)[begin_ + 1] = static_cast<std::byte>(size >> 8);
+        }
+    };
+
+    /// 逐位读取，先读低位。
+    class bit_reader {
+        std::span<const std::byte> buffer_;
+        size_t bit_count_{};
+
+    public:
+        explicit bit_reader(const std::span<const std::byte> buffer) : buffer_(buffer) {}
+
+        /// 读出 bits 位。
+        /// @exception std::runtime_error 读过了消息末尾的时候，抛出这个 exception。
+        uint64_t read(const size_t bits) {
+            if (bit_count_ + bits > buffer_.size() * 8) {
+                throw std::runtime_error("Truncated spectator message.");
+            }
+            uint64_t value = 0;
+            for (size_t read = 0; read < bits;) {
+                const auto offset = bit_count_ % 8;
+                const auto count = std::min(bits - read, 8 - offset);
+                const auto byte = static_cast<uint8_t>(buffer_[bit_count_ / 8]);
+                value |= static_cast<uint64_t>((byte >> offset) & ((1u << count) - 1)) << read;
+                read += count;
+                bit_count_ += count;
+            }
+            return value;
+        }
+
+        bool read_bool() { return read(1) != 0; }
+
+        uint64_t read_varint() {
+            uint64_t value = 0;
+            for (size_t shift = 0; shift < 64; shift += 4) {
+                const auto more = read_bool();
+                value |= read(4) << shift;
+                if (!more) {
+                    return value;
+                }
+            }
+            throw std::runtime_error("Malformed varint in spectator message.");
+        }
+    };
+
+    void write_block_type(bit_writer &writer, const BlockType block_type) {
+        writer.write(static_cast<uint8_t>(block_type), color_bits);
+    }
+
+    BlockType read_block_type(bit_reader &reader) {
+        const auto value = reader.read(color_bits);
+        if (value > static_cast<uint8_t>(BlockType::Garbage)) {
+            throw std::runtime_error("Bad block type in spectator message.");
+        }
+        return static_cast<BlockType>(value);
+    }
+
+    void write_row(bit_writer &writer, const std::array<BlockType, GameData::width> &row) {
+        for (const auto block_type: row) {
+            write_block_type(writer, block_type);
+        }
+    }
+
+    void read_row(bit_reader &reader, std::array<BlockType, GameData::width> &row) {
+        for (auto &block_type: row) {
+            block_type = read_block_type(reader);
+        }
+    }
+
+    void write_anchor(bit_writer &writer, const point<int32_t> anchor) {
+        writer.write(static_cast<uint64_t>(anchor.y + anchor_bias), anchor_y_bits);
+        writer.write(static_cast<uint64_t>(anchor.x + anchor_bias), anchor_x_bits);
+    }
+
+    point<int32_t> read_anchor(bit_reader &reader) {
+        const auto y = static_cast<int32_t>(reader.read(anchor_y_bits)) - anchor_bias;
+        const auto x = static_cast<int32_t>(reader.read(anchor_x_bits)) - anchor_bias;
+        return {y, x};
+    }
+
+    void write_keyframe(bit_writer &writer, const SpectatorState &state) {
+        writer.write(state.frame, 32);
+        for (const auto &row: state.matrix_color) {
+            write_row(writer, row);
+        }
+        write_block_type(writer, state.current_block_type);
+        writer.write(static_cast<uint8_t>(state.current_block_rotation_state), 2);
+        write_anchor(writer, state.current_block_anchor);
+        write_block_type(writer, state.hold_block_type);
+        writer.write_bool(state.can_exchange_hold);
+        for (const auto block_type: state.preview) {
+            write_block_type(writer, block_type);
+        }
+        writer.write(state.clear_line_count, 32);
+        writer.write(state.piece_count, 32);
+        writer.write_bool(state.topped_out);
+    }
+
+    SpectatorState read_keyframe(bit_reader &reader) {
+        SpectatorState state;
+        state.frame = static_cast<uint32_t>(reader.read(32));
+        for (auto &row: state.matrix_color) {
+            read_row(reader, row);
+        }
+        state.current_block_type = read_block_type(reader);
+        state.current_block_rotation_state = static_cast<RotationState>(reader.read(2));
+        state.current_block_anchor = read_anchor(reader);
+        state.hold_block_type = read_block_type(reader);
+        state.can_exchange_hold = reader.read_bool();
+        for (auto &block_type: state.preview) {
+            block_type = read_block_type(reader);
+        }
+        state.clear_line_count = static_cast<uint32_t>(reader.read(32));
+        state.piece_count = static_cast<uint32_t>(reader.read(32));
+        state.topped_out = reader.read_bool();
+        return state;
+    }
+
+    /// 差量帧的布局，每一段前面都有一位标记这一段有没有：
+    /// 1. 帧号：1 表示正好是上一条加一，否则跟着 32 位帧号
+    /// 2. 场地：变了的行的掩码，之后是这些行的颜色
+    /// 3. 当前方块：再用一位标记类型和旋转状态有没有变，之后是锚点
+    /// 4. 暂存块：类型和能否交换
+    /// 5. 预览：一位标记是不是整体往前移了一格，是的话只跟着新进来的一个，否则跟着全部
+    /// 6. 计数：消除行数和方块数的增量，变长整数
+    /// 7. 是否已经死了，总是有
+    void write_delta(bit_writer &writer, const SpectatorState &last, const SpectatorState &state) {
+        const auto next_frame = state.frame == last.frame + 1;
+        writer.write_bool(next_frame);
+        if (!next_frame) {
+            writer.write(state.frame, 32);
+        }
+
+        uint32_t changed_rows = 0;
+        for (size_t y = 0; y < matrix_height; y++) {
+            if (state.matrix_color[y] != last.matrix_color[y]) {
+                changed_rows |= 1u << y;
+            }
+        }
+        writer.write_bool(changed_rows != 0);
+        if (changed_rows != 0) {
+            writer.write(changed_rows, matrix_height);
+            for (auto rows = changed_rows; rows != 0; rows &= rows - 1) {
+                write_row(writer, state.matrix_color[static_cast<size_t>(std::countr_zero(rows))]);
+            }
+        }
+
+        const auto shape_changed = state.current_block_type != last.current_block_type ||
+                                   state.current_block_rotation_state != last.current_block_rotation_state;
+        const auto pose_changed = shape_changed || state.current_block_anchor != last.current_block_anchor;
+        writer.write_bool(pose_changed);
+        if (pose_changed) {
+            writer.write_bool(shape_changed);
+            if (shape_changed) {
+                write_block_type(writer, state.current_block_type);
+                writer.write(static_cast<uint8_t>(state.current_block_rotation_state), 2);
+            }
+            write_anchor(writer, state.current_block_anchor);
+        }
+
+        const auto hold_changed = state.hold_block_type != last.hold_block_type ||
+                                  state.can_exchange_hold != last.can_exchange_hold;
+        writer.write_bool(hold_changed);
+        if (hold_changed) {
+            write_block_type(writer, state.hold_block_type);
+            writer.write_bool(state.can_exchange_hold);
+        }
+
+        writer.write_bool(state.preview != last.preview);
+        if (state.preview != last.preview) {
+            const auto shifted = std::equal(last.preview.begin() + 1, last.preview.end(), state.preview.begin());
+            writer.write_bool(shifted);
+            if (shifted) {
+                write_block_type(writer, state.preview.back());
+            } else {
+                for (const auto block_type: state.preview) {
+                    write_block_type(writer, block_type);
+                }
+            }
+        }
+
+        // 计数只会增加
+        const auto counts_changed =
+                state.clear_line_count != last.clear_line_count || state.piece_count != last.piece_count;
+        writer.write_bool(counts_changed);
+        if (counts_changed) {
+            writer.write_varint(state.clear_line_count - last.clear_line_count);
+            writer.write_varint(state.piece_count - last.piece_count);
+        }
+
+        writer.write_bool(state.topped_out);
+    }
+
+    void read_delta(bit_reader &reader, SpectatorState &state) {
+        if (reader.read_bool()) {
+            state.frame++;
+        } else {
+            state.frame = static_cast<uint32_t>(reader.read(32));
+        }
+
+        if (reader.read_bool()) {
+            const auto changed_rows = static_cast<uint32_t>(reader.read(matrix_height));
+            for (auto rows = changed_rows; rows != 0; rows &= rows - 1) {
+                read_row(reader, state.matrix_color[static_cast<size_t>(std::countr_zero(rows))]);
+            }
+        }
+
+        if (reader.read_bool()) {
+            if (reader.read_bool()) {
+                state.current_block_type = read_block_type(reader);
+                state.current_block_rotation_state = static_cast<RotationState>(reader.read(2));
+            }
+            state.current_block_anchor = read_anchor(reader);
+        }
+
+        if (reader.read_bool()) {
+            state.hold_block_type = read_block_type(reader);
+            state.can_exchange_hold = reader.read_bool();
+        }
+
+        if (reader.read_bool()) {
+            if (reader.read_bool()) {
+                std::shift_left(state.preview.begin(), state.preview.end(), 1);
+                state.preview.back() = read_block_type(reader);
+            } else {
+                for (auto &block_type: state.preview) {
+                    block_type = read_block_type(reader);
+                }
+            }
+        }
+
+        if (reader.read_bool()) {
+            state.clear_line_count += static_cast<uint32_t>(reader.read_varint());
+            state.piece_count += static_cast<uint32_t>(reader.read_varint());
+        }
+
+        state.topped_out = reader.read_bool();
+    }
+} // namespace
+
+SpectatorState SpectatorState::capture(const GameData &game_data) {
+    SpectatorState state;
+    state.frame = static_cast<uint32_t>(game_data.logical_frame_count);
+    state.matrix_color = game_data.matrix_color;
+    state.current_block_type = game_data.current_block_type;
+    state.current_block_rotation_state = game_data.current_block_rotation_state;
+    state.current_block_anchor = game_data.current_block.anchor;
+    state.hold_block_type = game_data.hold_block_type;
+    state.can_exchange_hold = game_data.can_exchange_hold;
+    for (size_t idx = 0; idx < preview_count; idx++) {
+        state.preview[idx] = idx < game_data.next_queue.size() ? game_data.next_queue[idx] : BlockType::None;
+    }
+    state.clear_line_count = static_cast<uint32_t>(game_data.clear_line_count);
+    state.piece_count = static_cast<uint32_t>(game_data.piece_count);
+    state.topped_out = game_data.topped_out;
+    return state;
+}
+
+SpectatorEncoder::SpectatorEncoder(const size_t keyframe_interval) :
+    keyframe_interval_(std::max<size_t>(keyframe_interval, 1)) {}
+
+SpectatorEncoder::MessageType SpectatorEncoder::encode(const GameData &game_data, std::vector<std::byte> &buffer) {
+    return encode(SpectatorState::capture(game_data), buffer);
+}
+
+SpectatorEncoder::MessageType SpectatorEncoder::encode(const SpectatorState &state, std::vector<std::byte> &buffer) {
+    ZEETRIS_PROFILE_SCOPE("spectator.encode");
+    bit_writer writer{buffer};
+    // 计数变少了说明换了一局，差量表示不了
+    const auto keyframe = !last_ || since_keyframe_ >= keyframe_interval_ ||
+                          state.clear_line_count < last_->clear_line_count || state.piece_count < last_->piece_count;
+    if (keyframe) {
+        writer.write(static_cast<uint8_t>(MessageType::Keyframe), 8);
+        write_keyframe(writer, state);
+        since_keyframe_ = 1;
+    } else {
+        writer.write(static_cast<uint8_t>(MessageType::Delta), 8);
+        write_delta(writer, *last_, state);
+        since_keyframe_++;
+    }
+    writer.finish();
+    last_ = state;
+    return keyframe ? MessageType::Keyframe : MessageType::Delta;
+}
+
+size_t SpectatorDecoder::receive(const std::span<const std::byte> bytes) {
+    pending_.insert(pending_.end(), bytes.begin(), bytes.end());
+    size_t offset = 0;
+    size_t applied = 0;
+    while (pending_.size() - offset >= length_size) {
+        const auto size = static_cast<size_t>(pending_[offset]) | static_cast<size_t>(pending_[offset + 1]) << 8;
+        if (pending_.size() - offset - length_size < size) {
+            break;
+        }
+        apply(std::span{pending_}.subspan(offset + length_size, size));
+        offset += length_size + size;
+        applied++;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(offset));
+    return applied;
+}
+
+void SpectatorDecoder::apply(const std::span<const std::byte> message) {
+    bit_reader reader{message};
+    switch (static_cast<SpectatorEncoder::MessageType>(reader.read(8))) {
+        case SpectatorEncoder::MessageType::Keyframe:
+            state_ = read_keyframe(reader);
+            break;
+        case SpectatorEncoder::MessageType::Delta:
+            if (!state_) {
+                throw std::runtime_error("Spectator delta received before any keyframe.");
+            }
+            read_delta(reader, *state_);
+            break;
+        default:
+            throw std::runtime_error("Unknown spectator message type.");
+    }
+}
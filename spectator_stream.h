@@ -0,0 +1,123 @@
+#ifndef SPECTATOR_STREAM_H
+#define SPECTATOR_STREAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "game_data.h"
+
+
+/// 观战者看到的局面：画出一局游戏需要的全部东西，不含计划帧、随机数之类只有模拟才用得到的状态。
+class SpectatorState {
+public:
+    /// 预览的方块个数
+    static constexpr size_t preview_count = 5;
+
+    /// 逻辑帧计数
+    uint32_t frame{};
+    /// 场地的颜色平面
+    decltype(GameData::matrix_color) matrix_color{};
+    /// 当前方块的类型
+    BlockType current_block_type{BlockType::None};
+    /// 当前方块的旋转状态
+    RotationState current_block_rotation_state{RotationState::Zero};
+    /// 当前方块的锚点
+    point<int32_t> current_block_anchor{0, 0};
+    /// 暂存块的类型
+    BlockType hold_block_type{BlockType::None};
+    /// 是否可以交换暂存块
+    bool can_exchange_hold{true};
+    /// 预览序列的前 preview_count 个，不够的用 None 补齐
+    std::array<BlockType, preview_count> preview{};
+    /// 消除的总行数
+    uint32_t clear_line_count{};
+    /// 锁定的方块总数
+    uint32_t piece_count{};
+    /// 是否已经死了
+    bool topped_out{};
+
+    /// 从一局游戏里取出观战者看得到的部分。
+    /// @param game_data 游戏数据
+    /// @return 局面
+    static SpectatorState capture(const GameData &game_data);
+
+    /// 当前方块。
+    [[nodiscard]] block current_block() const {
+        return make_block(current_block_type, current_block_rotation_state, current_block_anchor);
+    }
+
+    bool operator==(const SpectatorState &state) const = default;
+};
+
+/// 观战流的编码端。
+///
+/// 每条消息前面是 2 字节小端序的长度，之后第一个字节是类型：
+/// - 关键帧 (1)：完整的 SpectatorState，每格 4 位，一共 130 字节左右
+/// - 差量帧 (2)：和上一条消息相比变了什么，逐位打包。场地只发变了的行，方块的位置、暂存块、
+///   预览和计数各用一位标记有没有变；什么都没变的一帧只有 4 个字节（含长度）
+///
+/// 每隔 keyframe_interval 帧发一次关键帧，中途加入的观战者最多等这么久就能开始看。
+/// 也可以调用 request_keyframe() 让下一条马上就是关键帧。
+class SpectatorEncoder {
+    /// 上一条消息之后观战者看到的局面，还没发过关键帧时为空
+    std::optional<SpectatorState> last_;
+    /// 距离上一个关键帧的消息条数
+    size_t since_keyframe_{};
+    /// 两个关键帧之间最多的消息条数
+    size_t keyframe_interval_;
+
+public:
+    /// 消息的类型
+    enum class MessageType : uint8_t {
+        Keyframe = 1,
+        Delta = 2,
+    };
+
+    /// 默认每秒一个关键帧
+    static constexpr size_t default_keyframe_interval = 60;
+
+    /// @param keyframe_interval 两个关键帧之间最多的消息条数
+    explicit SpectatorEncoder(size_t keyframe_interval = default_keyframe_interval);
+
+    /// 让下一条消息是关键帧。
+    void request_keyframe() { last_.reset(); }
+
+    /// 把这一帧的局面编码成一条消息，追加到 buffer 的末尾。
+    /// @param game_data 游戏数据
+    /// @param buffer 追加到这里
+    /// @return 这一条的类型
+    MessageType encode(const GameData &game_data, std::vector<std::byte> &buffer);
+
+    /// 同上，直接给出局面。
+    MessageType encode(const SpectatorState &state, std::vector<std::byte> &buffer);
+};
+
+/// 观战流的解码端。收到的字节流可以被切成任意段，凑成完整的消息才会应用。
+class SpectatorDecoder {
+    /// 当前的局面，收到第一个关键帧之前为空
+    std::optional<SpectatorState> state_;
+    /// 收到、但还没凑成一条完整消息的字节
+    std::vector<std::byte> pending_;
+
+public:
+    /// 处理收到的字节。
+    /// @param bytes 收到的字节
+    /// @return 应用了几条消息
+    /// @exception std::runtime_error 消息不合法，或者在关键帧之前收到差量帧的时候，抛出这个 exception。
+    size_t receive(std::span<const std::byte> bytes);
+
+    /// 应用一条消息，不含开头的长度。
+    /// @param message 消息
+    /// @exception std::runtime_error 同 receive()。
+    void apply(std::span<const std::byte> message);
+
+    /// 当前的局面，收到第一个关键帧之前返回 nullptr。
+    [[nodiscard]] const SpectatorState *state() const { return state_ ? &*state_ : nullptr; }
+};
+
+
+#endif // SPECTATOR_STREAM_H
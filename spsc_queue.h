@@ -0,0 +1,62 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+
+/// 单生产者单消费者的无锁环形队列，容量固定，不会分配内存。
+///
+/// 只能有一个线程 push，一个线程 pop。两边各自只写自己的下标，读对方的下标，都不会等待。
+/// @tparam T 元素类型
+/// @tparam Capacity 容量，必须是 2 的幂
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    /// 两个下标分开放在不同的缓存行上，免得生产者和消费者互相把对方的缓存行挤掉
+    static constexpr size_t cache_line_size = 64;
+
+    std::array<T, Capacity> slots_{};
+    /// 下一个要写的位置，只由生产者写。一直自增，用的时候再取模
+    alignas(cache_line_size) std::atomic_size_t tail_{};
+    /// 下一个要读的位置，只由消费者写
+    alignas(cache_line_size) std::atomic_size_t head_{};
+
+public:
+    SpscQueue() = default;
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// 生产者：放入一个元素。
+    /// @return 队列满了的时候返回 false，元素不会被放入
+    bool try_push(const T &value) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots_[tail % Capacity] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// 消费者：取出一个元素。
+    /// @return 队列为空的时候返回 nullopt
+    std::optional<T> try_pop() {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        T value = slots_[head % Capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    /// 容量。
+    static constexpr size_t capacity() { return Capacity; }
+};
+
+
+#endif // SPSC_QUEUE_H
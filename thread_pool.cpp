@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+
+
+namespace {
+    /// 当前线程所属的线程池
+    thread_local const ThreadPool *current_pool = nullptr;
+    /// 当前线程在所属线程池里的编号
+    thread_local size_t current_pool_index = SIZE_MAX;
+} // namespace
+
+ThreadPool::ThreadPool(const size_t thread_count) {
+    const auto count = std::max<size_t>(thread_count, 1);
+    for (size_t idx = 0; idx < count; idx++) {
+        queues_.push_back(std::make_unique<worker_queue>());
+    }
+    for (size_t idx = 0; idx < count; idx++) {
+        threads_.emplace_back([this, idx] { worker_loop_(idx); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        quit_ = true;
+    }
+    sleep_condition_.notify_all();
+    for (auto &thread: threads_) {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::current_index_() const {
+    return current_pool == this ? current_pool_index : SIZE_MAX;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    auto index = current_index_();
+    if (index == SIZE_MAX) {
+        index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    }
+    // 先计数再入队：任务一入队就可能被别的线程取走、执行完并减掉计数，后计数的话 pending_ 会暂时下溢
+    pending_.fetch_add(1);
+    {
+        std::lock_guard guard(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // 空的临界区，保证睡眠的线程不会错过这次唤醒
+        std::lock_guard guard(sleep_mutex_);
+    }
+    sleep_condition_.notify_one();
+}
+
+bool ThreadPool::try_run_one_(const size_t index) {
+    std::function<void()> task;
+    // 先看自己的队列（从尾部取），再从别的队列的头部偷
+    for (size_t offset = 0; offset < queues_.size() && !task; offset++) {
+        auto &[mutex, tasks] = *queues_[(index + offset) % queues_.size()];
+        std::lock_guard guard(mutex);
+        if (tasks.empty()) {
+            continue;
+        }
+        if (offset == 0) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        } else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    pending_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop_(const size_t index) {
+    current_pool = this;
+    current_pool_index = index;
+    while (true) {
+        if (try_run_one_(index)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        sleep_condition_.wait(lock, [this] { return quit_ || pending_ > 0; });
+        if (quit_) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(const size_t count, const std::function<void(size_t)> &func) {
+    if (count == 0) {
+        return;
+    }
+
+    // 每个线程分几块，让偷任务有东西可偷，又不至于每个数都是一个任务
+    const auto chunk_count = std::min(count, threads_.size() * 4);
+    const auto chunk_size = (count + chunk_count - 1) / chunk_count;
+    std::atomic_size_t remaining{chunk_count};
+    // func 的异常不能让它逃到工作线程外面，也不能让 remaining 减不到 0。记下第一个，全部结束之后再抛，
+    // 出错之后还没做的就不做了
+    std::exception_ptr exception;
+    std::atomic_flag failed{};
+    for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+        submit([&, chunk] {
+            try {
+                const auto end = std::min(count, (chunk + 1) * chunk_size);
+                for (size_t idx = chunk * chunk_size; idx < end && !failed.test(std::memory_order_relaxed); idx++) {
+                    func(idx);
+                }
+            } catch (...) {
+                if (!failed.test_and_set()) {
+                    exception = std::current_exception();
+                }
+            }
+            remaining.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    const auto index = current_index_() == SIZE_MAX ? 0 : current_index_();
+    while (remaining.load(std::memory_order_acquire) != 0) {
+        if (!try_run_one_(index)) {
+            std::this_thread::yield();
+        }
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
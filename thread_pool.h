@@ -0,0 +1,75 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// 工作窃取的线程池。
+///
+/// 每个工作线程有自己的任务队列：工作线程提交的任务放在自己队列的尾部，自己从尾部取（后进先出，缓存友好）；
+/// 自己的队列空了就从别的线程队列的头部偷。不是工作线程提交的任务轮流放进各个队列。
+class ThreadPool {
+    /// 一个工作线程的任务队列
+    class worker_queue {
+    public:
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /// 每个工作线程的任务队列
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    /// 工作线程
+    std::vector<std::thread> threads_;
+    /// 已经提交、还没有开始执行的任务数
+    std::atomic_size_t pending_{};
+    /// 非工作线程提交任务时轮到的队列
+    std::atomic_size_t next_queue_{};
+    /// 指示工作线程退出
+    std::atomic_bool quit_{false};
+    /// 没有任务时工作线程在这里睡眠
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_condition_;
+
+    /// 当前线程在这个线程池里的编号，不是这个线程池的工作线程时为 SIZE_MAX。
+    [[nodiscard]] size_t current_index_() const;
+
+    /// 从 index 号队列开始找一个任务来执行。
+    /// @return 是否执行了任务
+    bool try_run_one_(size_t index);
+
+    /// 工作线程的主循环。
+    void worker_loop_(size_t index);
+
+public:
+    /// @param thread_count 工作线程数，不填就是硬件线程数
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    /// 工作线程数。
+    [[nodiscard]] size_t thread_count() const { return threads_.size(); }
+
+    /// 提交一个任务。
+    /// @param task 要执行的任务
+    void submit(std::function<void()> task);
+
+    /// 并行地对 [0, count) 中的每个数执行 func，全部执行完之后才返回。
+    ///
+    /// 等待的时候调用者自己也会去执行任务，所以在工作线程里调用也不会死锁。
+    /// @param count 个数
+    /// @param func 要执行的函数
+    /// @exception func 抛出 exception 的时候，还没执行的数不再执行，等已经开始的都结束之后，
+    /// 在调用线程上重新抛出第一个 exception。
+    void parallel_for(size_t count, const std::function<void(size_t)> &func);
+};
+
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,87 @@
+#include "tick_log.h"
+
+
+TickLog::TickLog() {
+    for (size_t idx = 0; idx < capacity; idx++) {
+        slots_[idx].sequence.store(idx, std::memory_order_relaxed);
+    }
+}
+
+TickLog::~TickLog() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+TickLog &TickLog::instance() {
+    static TickLog tick_log;
+    return tick_log;
+}
+
+TickLog::slot *TickLog::claim_(size_t &position) {
+    position = tail_.load(std::memory_order_relaxed);
+    while (true) {
+        auto &slot = slots_[position % capacity];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            // 格子空着，和别的线程抢这个位置
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (sequence < position) {
+            // 这一格上一圈的记录还没被取走，缓冲区满了
+            return nullptr;
+        } else {
+            // 被别的线程抢先了
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t TickLog::drain() {
+    std::lock_guard guard(consumer_mutex_);
+    const auto logger = spdlog::default_logger_raw();
+    std::string message;
+    size_t count = 0;
+    while (true) {
+        auto &slot = slots_[head_ % capacity];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            break;
+        }
+        // 先拷出来再把格子还回去，格式化的时候不占着缓冲区
+        const auto value = slot.value;
+        slot.sequence.store(head_ + capacity, std::memory_order_release);
+        head_++;
+
+        value.format_to(value, message);
+        logger->log(value.time, spdlog::source_loc{}, value.level, message);
+        count++;
+    }
+
+    if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed); dropped != 0) {
+        logger->warn("Tick log buffer is full, dropped {} records", dropped);
+    }
+    return count;
+}
+
+void TickLog::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    thread_ = std::jthread{[this](const std::stop_token &stop_token) {
+        while (!stop_token.stop_requested()) {
+            drain();
+            std::this_thread::sleep_for(flush_interval);
+        }
+    }};
+}
+
+void TickLog::stop() {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+    drain();
+    spdlog::default_logger_raw()->flush();
+}
@@ -0,0 +1,171 @@
+#ifndef TICK_LOG_H
+#define TICK_LOG_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <mutex>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+
+/// 逻辑帧里用的日志。
+///
+/// 调用的线程只把格式串和参数的值拷进一个预先分配好的环形缓冲区，不格式化、不分配内存、不写文件；
+/// 后台线程每隔一会儿把记录取出来格式化，再交给 spdlog 的默认 logger。缓冲区满了就丢掉新的记录，并记下丢了几条。
+///
+/// 格式串必须是字面量，参数只能是可以直接按字节拷贝的值（整数、浮点数、枚举之类），不能是指针和字符串。
+/// 可以有多个线程同时写。
+///
+/// 不要直接调用 log()，用下面的 ZEETRIS_TICK_LOG_* 宏：低于 ZEETRIS_TICK_LOG_LEVEL 的调用在编译期就被去掉了，
+/// 连参数都不会求值。
+class TickLog {
+public:
+    /// 缓冲区能放下的记录数，必须是 2 的幂
+    static constexpr size_t capacity = 1024;
+    /// 一条记录最多能带多少字节的参数
+    static constexpr size_t payload_size = 32;
+    /// 后台线程每隔多久取一次记录
+    static constexpr std::chrono::milliseconds flush_interval{20};
+
+private:
+    static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    /// 一条还没有格式化的记录
+    class record {
+    public:
+        std::chrono::system_clock::time_point time;
+        spdlog::level::level_enum level{};
+        /// 格式串，是字面量
+        std::string_view format;
+        /// 按参数的类型把 payload 还原出来并格式化
+        void (*format_to)(const record &, std::string &){};
+        /// 参数的值，依次紧挨着放
+        std::array<std::byte, payload_size> payload{};
+    };
+
+    /// 缓冲区的一格。sequence 等于写入位置时可写，等于写入位置 + 1 时可读
+    class slot {
+    public:
+        std::atomic_size_t sequence;
+        record value;
+    };
+
+    std::array<slot, capacity> slots_;
+    /// 下一个要写的位置。一直自增，用的时候再取模
+    alignas(64) std::atomic_size_t tail_{};
+    /// 下一个要读的位置，只在持有 consumer_mutex_ 时访问
+    alignas(64) size_t head_{};
+    /// 缓冲区满了丢掉的记录数
+    std::atomic_size_t dropped_{};
+    /// 后台线程和 stop() 都会取记录
+    std::mutex consumer_mutex_;
+    /// 后台线程
+    std::jthread thread_;
+
+    TickLog();
+
+    /// 占一个可写的格子。
+    /// @param position 占到的写入位置
+    /// @return 缓冲区满了的时候返回 nullptr
+    slot *claim_(size_t &position);
+
+    /// 把 payload 按 Args 还原出来并格式化。
+    template<typename... Args>
+    static void format_record_(const record &record, std::string &message) {
+        std::tuple<Args...> values;
+        size_t offset = 0;
+        std::apply(
+                [&](auto &...value) {
+                    ((std::memcpy(&value, record.payload.data() + offset, sizeof value), offset += sizeof value),
+                     ...);
+                    message = std::vformat(record.format, std::make_format_args(value...));
+                },
+                values);
+    }
+
+public:
+    TickLog(const TickLog &) = delete;
+    TickLog &operator=(const TickLog &) = delete;
+    /// 只停下后台线程，不再取记录。析构发生在静态对象销毁的时候，那时 spdlog 可能已经没了，
+    /// 剩下的记录要在退出之前调用 stop() 交给 spdlog。
+    ~TickLog();
+
+    /// 全局唯一的日志缓冲区。
+    static TickLog &instance();
+
+    /// 写一条记录。
+    /// @param level 级别，低于 spdlog 当前的级别时直接丢掉
+    /// @param format 格式串
+    /// @param args 参数
+    template<typename... Args>
+    void log(const spdlog::level::level_enum level, const std::format_string<Args...> format, const Args &...args) {
+        static_assert(((std::is_trivially_copyable_v<Args> && std::is_default_constructible_v<Args> &&
+                        !std::is_pointer_v<Args>) &&
+                       ...),
+                      "TickLog arguments must be plain values");
+        static_assert((sizeof(Args) + ... + 0) <= payload_size, "Too many arguments for TickLog");
+
+        if (!spdlog::default_logger_raw()->should_log(level)) {
+            return;
+        }
+        size_t position;
+        const auto slot = claim_(position);
+        if (slot == nullptr) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto &value = slot->value;
+        value.time = std::chrono::system_clock::now();
+        value.level = level;
+        value.format = format.get();
+        value.format_to = &format_record_<Args...>;
+        size_t offset = 0;
+        ((std::memcpy(value.payload.data() + offset, &args, sizeof args), offset += sizeof args), ...);
+        slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    /// 取出所有已经写好的记录，格式化之后交给 spdlog。
+    /// @return 取出的记录数
+    size_t drain();
+
+    /// 启动后台线程。
+    void start();
+
+    /// 停下后台线程，并把剩下的记录都交给 spdlog。
+    void stop();
+};
+
+// 逻辑帧里的日志在编译期去掉的级别，默认保留 info 及以上。取值和 SPDLOG_ACTIVE_LEVEL 一样
+#ifndef ZEETRIS_TICK_LOG_LEVEL
+#define ZEETRIS_TICK_LOG_LEVEL SPDLOG_LEVEL_INFO
+#endif
+
+#if ZEETRIS_TICK_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define ZEETRIS_TICK_LOG_DEBUG(...) TickLog::instance().log(spdlog::level::debug, __VA_ARGS__)
+#else
+#define ZEETRIS_TICK_LOG_DEBUG(...) static_cast<void>(0)
+#endif
+
+#if ZEETRIS_TICK_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+#define ZEETRIS_TICK_LOG_INFO(...) TickLog::instance().log(spdlog::level::info, __VA_ARGS__)
+#else
+#define ZEETRIS_TICK_LOG_INFO(...) static_cast<void>(0)
+#endif
+
+#if ZEETRIS_TICK_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+#define ZEETRIS_TICK_LOG_WARN(...) TickLog::instance().log(spdlog::level::warn, __VA_ARGS__)
+#else
+#define ZEETRIS_TICK_LOG_WARN(...) static_cast<void>(0)
+#endif
+
+
+#endif // TICK_LOG_H
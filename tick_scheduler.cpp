@@ -0,0 +1,44 @@
+#include "tick_scheduler.h"
+
+#include <algorithm>
+
+
+TickScheduler::clock::time_point TickScheduler::deadline_of_(const int64_t tick) const {
+    // 每次都从 start_ 算起，整数个 1/60 秒转换到时钟的精度时只会舍入一次
+    return start_ + std::chrono::duration_cast<clock::duration>(period{tick});
+}
+
+void TickScheduler::start(const clock::time_point now) {
+    start_ = now;
+    next_tick_ = 1;
+    metrics_ = {};
+}
+
+size_t TickScheduler::begin_wakeup(const clock::time_point now) {
+    const auto deadline = next_deadline();
+    if (now < deadline) {
+        return 0;
+    }
+
+    // 到 now 为止已经到期了几帧。截止时间是舍入到时钟精度的，刚好卡在舍入误差里的时候也至少算一帧
+    const auto elapsed_ticks = std::chrono::duration_cast<period>(now - start_).count();
+    const auto due = static_cast<size_t>(std::max<int64_t>(elapsed_ticks - next_tick_ + 1, 1));
+    const auto run = std::min(due, max_catch_up_);
+
+    metrics_.wakeup_count++;
+    metrics_.tick_count += run;
+    metrics_.missed_tick_count += due - run;
+    metrics_.last_lateness = now - deadline;
+    metrics_.max_lateness = std::max(metrics_.max_lateness, metrics_.last_lateness);
+    metrics_.total_lateness += metrics_.last_lateness;
+
+    // 跳过的帧也算过去了，下一帧就是 now 之后的第一个截止时间
+    next_tick_ += static_cast<int64_t>(due);
+    return run;
+}
+
+void TickScheduler::end_wakeup(const clock::time_point now, const clock::time_point finished) {
+    metrics_.last_handler_duration = finished - now;
+    metrics_.max_handler_duration = std::max(metrics_.max_handler_duration, metrics_.last_handler_duration);
+    metrics_.total_handler_duration += metrics_.last_handler_duration;
+}
@@ -0,0 +1,94 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ratio>
+
+
+/// 逻辑帧调度的统计数据。
+class TickMetrics {
+public:
+    using duration = std::chrono::steady_clock::duration;
+
+    /// 跑过的逻辑帧数
+    size_t tick_count{};
+    /// 唤醒次数。落后的时候一次唤醒会补跑好几帧
+    size_t wakeup_count{};
+    /// 因为落后太多而直接跳过的逻辑帧数
+    size_t missed_tick_count{};
+
+    /// 唤醒时比最早到期的那一帧的截止时间晚了多久
+    duration last_lateness{};
+    duration max_lateness{};
+    duration total_lateness{};
+
+    /// 一次唤醒中处理所有逻辑帧花了多久
+    duration last_handler_duration{};
+    duration max_handler_duration{};
+    duration total_handler_duration{};
+
+    /// 平均迟到时间。
+    [[nodiscard]] duration mean_lateness() const {
+        return wakeup_count == 0 ? duration{} : total_lateness / static_cast<int64_t>(wakeup_count);
+    }
+
+    /// 平均处理时间。
+    [[nodiscard]] duration mean_handler_duration() const {
+        return wakeup_count == 0 ? duration{} : total_handler_duration / static_cast<int64_t>(wakeup_count);
+    }
+};
+
+/// 固定步长的逻辑帧调度器，不依赖具体的计时器。
+///
+/// 第 n 帧的截止时间总是 start + n * period，用 expires_at() 等到这个绝对时间，而不是每次都从“现在”往后推一个周期，
+/// 所以不管处理函数什么时候被调起、跑了多久，误差都不会累积。周期按有理数保存（1/60 秒不是整数纳秒），也不会有舍入的累积误差。
+///
+/// 唤醒晚了的时候，会把已经到期的帧一次补跑完，但一次最多补 max_catch_up 帧，再多的直接跳过并记到 missed_tick_count 里，
+/// 免得卡了一下之后一直追不上。
+class TickScheduler {
+public:
+    /// 逻辑帧的周期
+    using period = std::chrono::duration<int64_t, std::ratio<1, 60>>;
+    using clock = std::chrono::steady_clock;
+
+private:
+    /// 第 0 帧的截止时间
+    clock::time_point start_{};
+    /// 下一个要跑的帧的编号
+    int64_t next_tick_{};
+    /// 一次唤醒最多补跑几帧
+    size_t max_catch_up_;
+    /// 统计数据
+    TickMetrics metrics_{};
+
+    /// 第 tick 帧的截止时间。
+    [[nodiscard]] clock::time_point deadline_of_(int64_t tick) const;
+
+public:
+    /// @param max_catch_up 一次唤醒最多补跑几帧
+    explicit TickScheduler(size_t max_catch_up = 5) : max_catch_up_(max_catch_up) {}
+
+    /// 开始计时，第一帧在 now 之后一个周期到期。
+    void start(clock::time_point now);
+
+    /// 下一帧的截止时间，用来 expires_at()。
+    [[nodiscard]] clock::time_point next_deadline() const { return deadline_of_(next_tick_); }
+
+    /// 在计时器唤醒的时候调用，算出这次要跑几帧，然后把下一帧的截止时间往后推。
+    /// @param now 唤醒的时间
+    /// @return 这次要跑的帧数。计时器提前唤醒（没有帧到期）的时候是 0
+    size_t begin_wakeup(clock::time_point now);
+
+    /// 这次唤醒的所有帧都跑完之后调用，记录处理时间。
+    /// @param now begin_wakeup() 时传入的时间
+    /// @param finished 处理完的时间
+    void end_wakeup(clock::time_point now, clock::time_point finished);
+
+    /// 统计数据。
+    [[nodiscard]] const TickMetrics &metrics() const { return metrics_; }
+};
+
+
+#endif // TICK_SCHEDULER_H
@@ -0,0 +1,61 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+/// 三缓冲。一个写者、一个读者，双方都不会等待对方。
+///
+/// 写者总是写在自己的 back() 上，写完 publish()；读者 update() 之后从 front() 读到最新发布的那一份。
+/// 三份缓冲区分别归写者、读者和“中间”所有，交换所有权只需要一次原子 exchange，所以两边都是无等待的。
+/// 读者来不及读的时候，中间那一份会被更新的一份覆盖，读者只会看到最新的。
+template<typename T>
+class TripleBuffer {
+    /// 中间那一份的编号里表示“写者发布之后读者还没取走”的位
+    static constexpr uint8_t fresh_bit = 0b100;
+    /// 中间那一份的编号里表示下标的位
+    static constexpr uint8_t index_mask = 0b011;
+
+    std::array<T, 3> buffers_{};
+    /// 中间那一份的下标，以及 fresh_bit
+    std::atomic_uint8_t middle_{1};
+    /// 写者的那一份的下标，只有写者会访问
+    uint8_t back_{0};
+    /// 读者的那一份的下标，只有读者会访问
+    uint8_t front_{2};
+
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    /// 写者：正在写的那一份。里面是两次发布之前的旧内容。
+    T &back() { return buffers_[back_]; }
+
+    /// 写者：发布 back()，之后 back() 会换成另一份。
+    void publish() {
+        back_ = middle_.exchange(static_cast<uint8_t>(back_ | fresh_bit), std::memory_order_acq_rel) & index_mask;
+    }
+
+    /// 写者：上一次发布的那一份是否还没有被读者取走。
+    /// 返回 false 之后就不会再变回 true；返回 true 的时候读者随时可能把它取走。
+    [[nodiscard]] bool unread() const { return (middle_.load(std::memory_order_acquire) & fresh_bit) != 0; }
+
+    /// 读者：如果有新发布的一份，就把它换到 front()。
+    /// @return 是否换到了新的一份
+    bool update() {
+        if ((middle_.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+            return false;
+        }
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    /// 读者：最近一次 update() 取到的那一份。
+    [[nodiscard]] const T &front() const { return buffers_[front_]; }
+};
+
+
+#endif // TRIPLE_BUFFER_H
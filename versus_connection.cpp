@@ -0,0 +1,113 @@
+#include "versus_connection.h"
+
+#include <spdlog/spdlog.h>
+
+
+VersusConnection::VersusConnection(boost::asio::io_context &io_context, VersusEndpoint endpoint, VersusMatch &match,
+                                   std::function<void()> on_received) :
+    endpoint_(std::move(endpoint)), socket_(io_context), resolver_(io_context), match_(&match),
+    on_received_(std::move(on_received)) {}
+
+void VersusConnection::start() {
+    if (endpoint_.host.empty()) {
+        acceptor_.emplace(socket_.get_executor(),
+                          boost::asio::ip::tcp::endpoint{boost::asio::ip::tcp::v4(), endpoint_.port});
+        spdlog::info("Waiting for an opponent on port {}...", endpoint_.port);
+        acceptor_->async_accept(socket_, [this](const boost::system::error_code &error_code) {
+            if (!fail_on_(error_code)) {
+                on_connected_();
+            }
+        });
+        return;
+    }
+
+    spdlog::info("Connecting to {}:{}...", endpoint_.host, endpoint_.port);
+    resolver_.async_resolve(
+            endpoint_.host, std::to_string(endpoint_.port),
+            [this](const boost::system::error_code &error_code,
+                   const boost::asio::ip::tcp::resolver::results_type &results) {
+                if (fail_on_(error_code)) {
+                    return;
+                }
+                boost::asio::async_connect(
+                        socket_, results,
+                        [this](const boost::system::error_code &connect_error_code, const auto &) {
+                            if (!fail_on_(connect_error_code)) {
+                                on_connected_();
+                            }
+                        });
+            });
+}
+
+void VersusConnection::on_connected_() {
+    acceptor_.reset();
+    // 每条消息只有几个字节，不能让它们在内核里攒着等凑成一个包
+    socket_.set_option(boost::asio::ip::tcp::no_delay{true});
+    connected_ = true;
+    spdlog::info("Connected to {}", socket_.remote_endpoint().address().to_string());
+    read_();
+    flush();
+}
+
+bool VersusConnection::fail_on_(const boost::system::error_code &error_code) {
+    if (!error_code) {
+        return false;
+    }
+    // 自己 close() 的时候挂着的操作都会以 operation_aborted 结束，不用报
+    if (error_code != boost::asio::error::operation_aborted) {
+        spdlog::warn("Versus connection closed: {}", error_code.message());
+    }
+    close();
+    return true;
+}
+
+void VersusConnection::read_() {
+    socket_.async_read_some(
+            boost::asio::buffer(read_buffer_), [this](const boost::system::error_code &error_code, const size_t size) {
+                if (fail_on_(error_code)) {
+                    return;
+                }
+                try {
+                    match_->receive(std::span{read_buffer_}.first(size));
+                } catch (const std::exception &exception) {
+                    spdlog::error("Bad data from the opponent: {}", exception.what());
+                    close();
+                    return;
+                }
+                if (on_received_) {
+                    on_received_();
+                }
+                read_();
+            });
+}
+
+void VersusConnection::flush() {
+    if (!connected() || write_in_flight_ || match_->outbox().empty()) {
+        return;
+    }
+    writing_.assign(match_->outbox().begin(), match_->outbox().end());
+    match_->clear_outbox();
+    write_in_flight_ = true;
+    boost::asio::async_write(socket_, boost::asio::buffer(writing_),
+                             [this](const boost::system::error_code &error_code, size_t) {
+                                 write_in_flight_ = false;
+                                 if (!fail_on_(error_code)) {
+                                     // 发送的时候攒下的消息接着发
+                                     flush();
+                                 }
+                             });
+}
+
+void VersusConnection::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    boost::system::error_code error_code;
+    if (acceptor_) {
+        acceptor_->close(error_code);
+    }
+    resolver_.cancel();
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, error_code);
+    socket_.close(error_code);
+}
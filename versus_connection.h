@@ -0,0 +1,90 @@
+#ifndef VERSUS_CONNECTION_H
+#define VERSUS_CONNECTION_H
+
+#include <array>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "versus_match.h"
+
+
+/// 对战的对手在哪里。
+class VersusEndpoint {
+public:
+    /// 对手的地址。为空时自己当主机，在 port 上等对手连上来
+    std::string host;
+    /// 端口
+    uint16_t port{};
+};
+
+/// 对战的 TCP 连接。
+///
+/// 连接、收发都挂在逻辑线程的 io_context 上，不另开线程：收到的字节在读完成的回调里直接交给 VersusMatch，
+/// 对手的镜像马上就推进了；自己推进一帧之后调用 flush()，这一帧马上就发出去。关掉了 Nagle 算法，
+/// 在局域网里从一方按键到另一方看到，远远用不了一个逻辑帧。
+class VersusConnection {
+    /// 对手在哪里
+    VersusEndpoint endpoint_;
+    boost::asio::ip::tcp::socket socket_;
+    /// 当主机时等对手连上来用的
+    std::optional<boost::asio::ip::tcp::acceptor> acceptor_;
+    boost::asio::ip::tcp::resolver resolver_;
+    /// 对战的一方，由外部持有
+    VersusMatch *match_;
+    /// 收到消息、推进了对手的镜像之后调用
+    std::function<void()> on_received_;
+
+    std::array<std::byte, 1024> read_buffer_{};
+    /// 正在发送的字节。发送完成之前，新的消息先攒在 VersusMatch 的发件箱里
+    std::vector<std::byte> writing_;
+    /// 是否有一个发送还没完成
+    bool write_in_flight_{false};
+    /// 是否已经连上了
+    bool connected_{false};
+    /// 连接是否已经断开
+    bool closed_{false};
+
+    /// 连上之后：开始收消息，并把发件箱里的握手发出去。
+    void on_connected_();
+
+    /// 开始读。
+    void read_();
+
+    /// 出错了就写日志并断开。
+    /// @return 是否出错了
+    bool fail_on_(const boost::system::error_code &error_code);
+
+public:
+    /// @param io_context 逻辑线程的 io_context
+    /// @param endpoint 对手在哪里
+    /// @param match 对战的一方，要比 VersusConnection 活得久
+    /// @param on_received 收到消息之后调用
+    VersusConnection(boost::asio::io_context &io_context, VersusEndpoint endpoint, VersusMatch &match,
+                     std::function<void()> on_received);
+    VersusConnection(const VersusConnection &) = delete;
+    VersusConnection &operator=(const VersusConnection &) = delete;
+
+    /// 开始连接：endpoint 的 host 为空时在 port 上等对手连上来，否则连到 host:port。不会阻塞。
+    /// @exception boost::system::system_error 端口监听不了的时候，抛出这个 exception。
+    void start();
+
+    /// 把 VersusMatch 发件箱里的字节发出去。上一次还没发完的话，等它发完再发。
+    void flush();
+
+    /// 断开连接。挂着的读写都会被取消，io_context 就可以退出了。
+    void close();
+
+    /// 是否已经连上了。
+    [[nodiscard]] bool connected() const { return connected_ && !closed_; }
+
+    /// 连接是否已经断开。
+    [[nodiscard]] bool closed() const { return closed_; }
+};
+
+
+#endif // VERSUS_CONNECTION_H
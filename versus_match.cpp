@@ -0,0 +1,90 @@
+#include "versus_match.h"
+
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <variant>
+
+
+VersusMatch::VersusMatch(GameData &local, const uint64_t seed) : local_(&local) {
+    VersusProtocol::encode(VersusHello{seed}, outbox_);
+}
+
+void VersusMatch::step_local(const FrameInput &input) {
+    // 自己死了之后就停在死的那一帧，等对手的镜像追上来再定输赢
+    if (local_->topped_out || result() != VersusResult::Playing) {
+        return;
+    }
+
+    // 对手的镜像打出的攻击，就是对手那边真正打出的攻击
+    uint32_t garbage = 0;
+    if (remote_) {
+        garbage = std::min<uint32_t>(remote_->outgoing_attack, UINT8_MAX);
+        remote_->outgoing_attack -= garbage;
+    }
+    VersusFrame frame{static_cast<uint32_t>(local_->logical_frame_count), input, static_cast<uint8_t>(garbage)};
+    local_->receive_garbage(garbage);
+    local_->step(input);
+    frame.hash = static_cast<uint32_t>(local_->hash());
+    VersusProtocol::encode(frame, outbox_);
+}
+
+void VersusMatch::receive(const std::span<const std::byte> bytes) {
+    inbox_.insert(inbox_.end(), bytes.begin(), bytes.end());
+    size_t offset = 0;
+    VersusMessage message;
+    while (const auto length = VersusProtocol::decode(std::span{inbox_}.subspan(offset), message)) {
+        handle_(message);
+        offset += length;
+    }
+    inbox_.erase(inbox_.begin(), inbox_.begin() + static_cast<std::ptrdiff_t>(offset));
+}
+
+void VersusMatch::handle_(const VersusMessage &message) {
+    if (const auto hello = std::get_if<VersusHello>(&message)) {
+        if (remote_) {
+            throw std::runtime_error("Duplicate versus handshake.");
+        }
+        remote_.emplace(hello->seed);
+        remote_->start();
+        predictor_.confirm(*remote_, FrameInput{});
+        return;
+    }
+
+    const auto &frame = std::get<VersusFrame>(message);
+    if (!remote_) {
+        throw std::runtime_error("Versus frame received before the handshake.");
+    }
+    if (frame.frame != remote_->logical_frame_count) {
+        throw std::runtime_error("Versus frame out of order.");
+    }
+    remote_->receive_garbage(frame.garbage);
+    remote_->step(frame.input);
+    if (static_cast<uint32_t>(remote_->hash()) != frame.hash) {
+        throw std::runtime_error(std::format("Versus desync at frame {}.", frame.frame));
+    }
+    predictor_.confirm(*remote_, frame.input);
+}
+
+VersusResult VersusMatch::result() const {
+    const auto remote_topped_out = remote_ && remote_->topped_out;
+    // 断开之后对手的镜像不会再推进，还没分出的输赢就再也分不出来了
+    const auto undecided = disconnected_ ? VersusResult::Disconnected : VersusResult::Playing;
+    if (local_->topped_out && remote_topped_out) {
+        // 都死了的话，先死的输。两边都是在死的那一帧之后停下来的，帧数就是死的时间
+        if (local_->logical_frame_count == remote_->logical_frame_count) {
+            return VersusResult::Draw;
+        }
+        return local_->logical_frame_count < remote_->logical_frame_count ? VersusResult::Lost : VersusResult::Won;
+    }
+    // 只有一边死了的时候，要等另一边活着走到同一帧才知道谁先死。对手的镜像比自己落后一个网络延迟，
+    // 不等的话，自己死了之后先判输，对手更早死的那几帧到了又变成赢
+    if (local_->topped_out) {
+        return remote_ && remote_->logical_frame_count >= local_->logical_frame_count ? VersusResult::Lost
+                                                                                       : undecided;
+    }
+    if (remote_topped_out) {
+        return local_->logical_frame_count >= remote_->logical_frame_count ? VersusResult::Won : undecided;
+    }
+    return undecided;
+}
@@ -0,0 +1,91 @@
+#ifndef VERSUS_MATCH_H
+#define VERSUS_MATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "game_data.h"
+#include "rollback.h"
+#include "versus_protocol.h"
+
+
+/// 对战的结果。
+enum class VersusResult : uint8_t {
+    /// 还在打
+    Playing = 0,
+    /// 对手先死了
+    Won,
+    /// 自己先死了
+    Lost,
+    /// 同一帧死的
+    Draw,
+    /// 还没分出输赢，连接就断开了
+    Disconnected,
+};
+
+/// 一场对战中的一方。不涉及网络，只负责两局游戏之间的垃圾交换和消息的编解码。
+///
+/// 自己的一局由外部持有，这里只推进它；对手的一局是按收到的种子和输入模拟出来的镜像。
+/// 镜像打出的攻击在自己的下一帧之前送进自己的一局，收到的行数随着这一帧的输入一起发给对手，
+/// 对手那边的镜像也就会在同一帧收到同样的垃圾，两边的模拟始终一致。
+///
+/// 不是线程安全的，应当只在一个线程（逻辑线程）上使用。
+class VersusMatch {
+    /// 自己的一局
+    GameData *local_;
+    /// 对手的镜像，收到握手之后才有
+    std::optional<GameData> remote_;
+    /// 从对手的镜像往前预测到自己这一帧，只用来显示
+    RollbackPredictor predictor_;
+    /// 还没发出去的字节
+    std::vector<std::byte> outbox_;
+    /// 收到、但还没凑成一条完整消息的字节
+    std::vector<std::byte> inbox_;
+    /// 连接是否已经断开
+    bool disconnected_{false};
+
+    /// 处理一条收到的消息。
+    void handle_(const VersusMessage &message);
+
+public:
+    /// @param local 自己的一局，必须已经 start() 过了，而且要比 VersusMatch 活得久
+    /// @param seed 自己这一局的种子
+    VersusMatch(GameData &local, uint64_t seed);
+
+    /// 推进自己的一局一帧：先收下对手的镜像打出的攻击，再 step()，然后把这一帧放进发件箱。
+    ///
+    /// 自己死了之后，或者对战结束之后，什么都不做。
+    /// @param input 这一帧的输入
+    void step_local(const FrameInput &input);
+
+    /// 处理从对手那里收到的字节。凑成完整的消息就马上推进对手的镜像。
+    /// @param bytes 收到的字节
+    /// @exception std::runtime_error 消息不合法、帧号对不上，或者镜像和对手的哈希对不上（不同步了）的时候，
+    /// 抛出这个 exception。
+    void receive(std::span<const std::byte> bytes);
+
+    /// 还没发出去的字节。发出去之后调用 clear_outbox()。
+    [[nodiscard]] const std::vector<std::byte> &outbox() const { return outbox_; }
+
+    /// 清空发件箱。
+    void clear_outbox() { outbox_.clear(); }
+
+    /// 连接断开了（对手走了，或者发来了不合法的数据）。对手的镜像不会再推进，还没分出输赢的话结果是 Disconnected。
+    void disconnect() { disconnected_ = true; }
+
+    /// 对手的镜像，还没收到握手时返回 nullptr。只按收到的输入推进，比自己落后一个网络延迟。
+    [[nodiscard]] const GameData *remote() const { return remote_ ? &*remote_ : nullptr; }
+
+    /// 从对手的镜像往前预测到自己这一帧的局面，见 RollbackPredictor。还没收到握手时返回 nullptr。
+    const GameData *predicted_remote() { return predictor_.predict(local_->logical_frame_count); }
+
+    /// 对战的结果。一边死了之后，要等另一边活着走到同一帧才判输赢，在那之前还是 Playing，
+    /// 所以结果一旦不是 Playing 就不会再变。在那之前连接断开了的话是 Disconnected。
+    [[nodiscard]] VersusResult result() const;
+};
+
+
+#endif // VERSUS_MATCH_H
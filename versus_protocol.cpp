@@ -0,0 +1,83 @@
+#include "versus_protocol.h"
+
+#include <array>
+#include <stdexcept>
+
+
+namespace {
+    /// 消息的类型
+    enum class message_type : uint8_t {
+        Hello = 1,
+        Frame = 2,
+    };
+
+    /// 魔数 "ZV"
+    constexpr std::array magic{std::byte{'Z'}, std::byte{'V'}};
+
+    /// 以小端序追加一个定长整数。
+    template<typename T>
+    void write_fixed(std::vector<std::byte> &buffer, T value) {
+        for (size_t idx = 0; idx < sizeof(T); idx++) {
+            buffer.push_back(static_cast<std::byte>(value & 0xff));
+            value >>= 8;
+        }
+    }
+
+    /// 以小端序读取一个定长整数。
+    template<typename T>
+    T read_fixed(const std::span<const std::byte> buffer, const size_t offset) {
+        T value{};
+        for (size_t idx = 0; idx < sizeof(T); idx++) {
+            value |= static_cast<T>(static_cast<T>(buffer[offset + idx]) << (idx * 8));
+        }
+        return value;
+    }
+} // namespace
+
+void VersusProtocol::encode(const VersusMessage &message, std::vector<std::byte> &buffer) {
+    if (const auto hello = std::get_if<VersusHello>(&message)) {
+        buffer.push_back(static_cast<std::byte>(message_type::Hello));
+        buffer.insert(buffer.end(), magic.begin(), magic.end());
+        buffer.push_back(static_cast<std::byte>(version));
+        write_fixed(buffer, hello->seed);
+    } else {
+        const auto &frame = std::get<VersusFrame>(message);
+        buffer.push_back(static_cast<std::byte>(message_type::Frame));
+        write_fixed(buffer, frame.frame);
+        buffer.push_back(static_cast<std::byte>(frame.input.pressed));
+        buffer.push_back(static_cast<std::byte>(frame.input.pressing));
+        buffer.push_back(static_cast<std::byte>(frame.garbage));
+        write_fixed(buffer, frame.hash);
+    }
+}
+
+size_t VersusProtocol::decode(const std::span<const std::byte> buffer, VersusMessage &message) {
+    if (buffer.empty()) {
+        return 0;
+    }
+    switch (static_cast<message_type>(buffer[0])) {
+        case message_type::Hello:
+            if (buffer.size() < hello_size) {
+                return 0;
+            }
+            if (buffer[1] != magic[0] || buffer[2] != magic[1]) {
+                throw std::runtime_error("Bad magic in versus handshake.");
+            }
+            if (static_cast<uint8_t>(buffer[3]) != version) {
+                throw std::runtime_error("Unsupported versus protocol version.");
+            }
+            message = VersusHello{read_fixed<uint64_t>(buffer, 4)};
+            return hello_size;
+        case message_type::Frame:
+            if (buffer.size() < frame_size) {
+                return 0;
+            }
+            message = VersusFrame{read_fixed<uint32_t>(buffer, 1),
+                                  {static_cast<uint8_t>(buffer[5]), static_cast<uint8_t>(buffer[6])},
+                                  static_cast<uint8_t>(buffer[7]),
+                                  read_fixed<uint32_t>(buffer, 8)};
+            return frame_size;
+        default:
+            throw std::runtime_error("Unknown versus message type.");
+    }
+}
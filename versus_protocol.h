@@ -0,0 +1,70 @@
+#ifndef VERSUS_PROTOCOL_H
+#define VERSUS_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "game_data.h"
+
+
+/// 对战开始时互相发送的握手消息。
+class VersusHello {
+public:
+    /// 发送方这一局的种子，接收方用它开一局一样的镜像
+    uint64_t seed{};
+
+    bool operator==(const VersusHello &hello) const = default;
+};
+
+/// 发送方推进了一帧。
+class VersusFrame {
+public:
+    /// 发送方推进的是第几帧，即 step() 之前的 logical_frame_count
+    uint32_t frame{};
+    /// 这一帧的输入
+    FrameInput input{};
+    /// 这一帧之前收到的垃圾行数，即 step() 之前调用 receive_garbage() 的参数
+    uint8_t garbage{};
+    /// 发送方推进了这一帧之后 GameData::hash() 的低 32 位，接收方的镜像推进之后对一下，不一样就是不同步了
+    uint32_t hash{};
+
+    bool operator==(const VersusFrame &frame) const = default;
+};
+
+using VersusMessage = std::variant<VersusHello, VersusFrame>;
+
+/// 对战协议。
+///
+/// 每条消息以一个字节的类型开头，之后是定长的内容，整数都是小端序：
+/// - Hello (12 字节)：类型 1、魔数 "ZV"、版本、种子 (u64)
+/// - Frame (12 字节)：类型 2、帧号 (u32)、pressed (u8)、pressing (u8)、垃圾行数 (u8)、哈希 (u32)
+///
+/// 双方各自模拟自己的一局，每推进一帧就把输入发给对方；对方用同样的种子和输入模拟出一个镜像，
+/// 镜像打出的攻击就是自己要收的垃圾。所以不需要单独发送攻击，也不需要等对方。
+class VersusProtocol {
+public:
+    /// 协议的版本，不一样就不能对战
+    static constexpr uint8_t version = 3;
+    /// Hello 消息的长度
+    static constexpr size_t hello_size = 12;
+    /// Frame 消息的长度
+    static constexpr size_t frame_size = 12;
+
+    /// 把一条消息编码之后追加到 buffer 的末尾。
+    /// @param message 消息
+    /// @param buffer 追加到这里
+    static void encode(const VersusMessage &message, std::vector<std::byte> &buffer);
+
+    /// 从 buffer 的开头解出一条消息。
+    /// @param buffer 收到的字节
+    /// @param message 解出的消息
+    /// @return 这条消息的长度；buffer 里还不是一条完整的消息时返回 0
+    /// @exception std::runtime_error 类型、魔数或者版本不对的时候，抛出这个 exception。
+    static size_t decode(std::span<const std::byte> buffer, VersusMessage &message);
+};
+
+
+#endif // VERSUS_PROTOCOL_H
@@ -0,0 +1,116 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "rng.h"
+
+
+enum class BlockType : int8_t;
+enum class RotationState;
+
+/// Zobrist 哈希的键。
+///
+/// 局面的哈希是它的每一个特征（每个被占用的格子、当前方块的类型和位置、暂存块……）对应的键的异或，
+/// 所以某个特征变了，只要把它原来的键和现在的键各异或一次。键在编译期由固定的种子生成，
+/// 所有平台、所有进程都一样，两台机器上同一个局面的哈希可以直接比较。
+class Zobrist {
+public:
+    /// 最多的行数，即 GameData::dirty_rows 的位数
+    static constexpr size_t max_rows = 32;
+    /// 最多的列数，即 GameData::matrix 一行的位数
+    static constexpr size_t max_columns = 16;
+    /// BlockType 的取值只用低 4 位
+    static constexpr size_t block_type_count = 16;
+    /// 锚点坐标加上这个偏移再查表，出生点上面和墙外面的坐标也能用
+    static constexpr int32_t anchor_bias = 16;
+    /// 锚点坐标的取值个数
+    static constexpr size_t anchor_range = 64;
+
+private:
+    class key_table {
+    public:
+        std::array<std::array<uint64_t, max_columns>, max_rows> cells;
+        std::array<std::array<uint64_t, 4>, block_type_count> current_blocks;
+        std::array<uint64_t, anchor_range> anchor_ys;
+        std::array<uint64_t, anchor_range> anchor_xs;
+        std::array<uint64_t, block_type_count> hold_blocks;
+        /// 可以交换暂存块时异或上
+        uint64_t can_exchange_hold;
+        std::array<uint64_t, block_type_count> queue_heads;
+    };
+
+    static constexpr key_table keys = [] {
+        // "Zeetris2"
+        SplitMix64 generator{0x5a65657472697332};
+        key_table table{};
+        for (auto &row: table.cells) {
+            for (auto &key: row) {
+                key = generator();
+            }
+        }
+        for (auto &rotations: table.current_blocks) {
+            for (auto &key: rotations) {
+                key = generator();
+            }
+        }
+        for (auto &key: table.anchor_ys) {
+            key = generator();
+        }
+        for (auto &key: table.anchor_xs) {
+            key = generator();
+        }
+        for (auto &key: table.hold_blocks) {
+            key = generator();
+        }
+        table.can_exchange_hold = generator();
+        for (auto &key: table.queue_heads) {
+            key = generator();
+        }
+        return table;
+    }();
+
+    static constexpr size_t index_(const BlockType block_type) {
+        return static_cast<uint8_t>(block_type) & (block_type_count - 1);
+    }
+
+    static constexpr size_t anchor_index_(const int32_t coordinate) {
+        return static_cast<size_t>(coordinate + anchor_bias) & (anchor_range - 1);
+    }
+
+public:
+    /// 一个格子的键。
+    static constexpr uint64_t cell(const size_t y, const size_t x) { return keys.cells[y][x]; }
+
+    /// 一行的哈希，即这一行被占用的格子的键的异或。
+    /// @param y 行
+    /// @param row 这一行的占用位图
+    static constexpr uint64_t row(const size_t y, uint16_t row) {
+        uint64_t hash = 0;
+        for (; row != 0; row &= row - 1) {
+            hash ^= keys.cells[y][std::countr_zero(row)];
+        }
+        return hash;
+    }
+
+    /// 当前方块的键。
+    static constexpr uint64_t current_block(const BlockType block_type, const RotationState rotation_state,
+                                            const int32_t anchor_y, const int32_t anchor_x) {
+        return keys.current_blocks[index_(block_type)][static_cast<size_t>(rotation_state) & 3] ^
+               keys.anchor_ys[anchor_index_(anchor_y)] ^ keys.anchor_xs[anchor_index_(anchor_x)];
+    }
+
+    /// 暂存块的键。
+    static constexpr uint64_t hold(const BlockType block_type, const bool can_exchange_hold) {
+        return keys.hold_blocks[index_(block_type)] ^ (can_exchange_hold ? keys.can_exchange_hold : 0);
+    }
+
+    /// 预览序列队首的键。
+    static constexpr uint64_t queue_head(const BlockType block_type) { return keys.queue_heads[index_(block_type)]; }
+};
+
+
+#endif // ZOBRIST_H